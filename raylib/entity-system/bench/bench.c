@@ -0,0 +1,267 @@
+/*******************************************************************************************
+*
+*   entity: headless benchmark of the entity system
+*
+*   Times the entity core on standard hierarchies without opening a window, results are
+*   printed as JSON (ns per entity, best of all repeats) to be diffed between versions,
+*   with the spatial index share of every world pass listed apart when it is enabled
+*
+*   usage: bench [entities] [repeats] [threads] [spatial]
+*
+*   Copyright (c) 2021 Christophe TES (@seyhajin)
+*
+********************************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../entity.h"
+
+//--------------------------------------
+// types/structures declaration
+//--------------------------------------
+
+typedef enum bench_shape_e {
+    SHAPE_CHAIN = 0,    // chains of BENCH_CHAIN_DEPTH entities, each the child of the previous one
+    SHAPE_FAN,          // every entity is a child of a single root
+    SHAPE_TREE4,        // balanced 4-ary tree
+    SHAPE_FOREST,       // random parents, 1 in 16 entities is a root
+    SHAPE_COUNT
+} bench_shape_t;
+
+typedef enum bench_op_e {
+    OP_CREATE = 0,      // create_entity
+    OP_SET_PARENT,      // entity_set_parent, building the shape
+    OP_WORLD_BUILD,     // first entity_update_world_all
+    OP_TURN,            // turn_entity on every entity
+    OP_WORLD_TURN,      // entity_update_world_all after turn
+    OP_MOVE,            // move_entity on every entity
+    OP_WORLD_MOVE,      // entity_update_world_all after move
+    OP_SPAWN,           // move_entity on every entity far out of its index leaf, and create_entity once
+    OP_WORLD_SPAWN,     // entity_update_world_all after spawn
+    OP_GET_WORLD,       // entity_get_tform(TFORM_WORLD) on every resolved entity
+    OP_WORLD_LAZY,      // entity_get_tform(TFORM_WORLD) on every entity right after turning the roots
+    OP_ANIMATE,         // entity_animate of a clip with one track per entity
+    OP_WORLD_ANIMATE,   // entity_update_world_all after animate
+    OP_FREE,            // free_entity on every root
+    OP_LOAD_SCENE,      // entity_load_scene of the whole hierarchy
+    OP_WORLD_LOAD,      // entity_update_world_all after load
+    OP_COUNT
+} bench_op_t;
+
+#define BENCH_CHAIN_DEPTH   1024
+#define BENCH_SCENE         "bench_scene.ents"
+
+static const char *bench_shapes[SHAPE_COUNT] = { "chain", "fan", "tree4", "forest" };
+static const char *bench_ops[OP_COUNT] = {
+    "create", "set_parent", "world_build", "turn", "world_turn",
+    "move", "world_move", "spawn", "world_spawn", "get_world", "world_lazy", "animate", "world_animate", "free",
+    "load_scene", "world_load"
+};
+
+//--------------------------------------
+// Global Variables Definition
+//--------------------------------------
+static entity_id_t *ids = NULL;
+static int *parents = NULL;     // index of the parent of each entity, -1 for roots
+static unsigned int seed = 1;
+static volatile float sink = 0.f;
+static entity_clip_t *clip = NULL;  // one track per entity, turning a quarter around y
+
+//--------------------------------------
+// Module Functions Declaration
+//--------------------------------------
+double bench_now(void);
+unsigned int bench_rand(void);
+void bench_shape(bench_shape_t shape, int count);
+void bench_run(int count, double *best, double *index);
+
+//----------------------------------------------------------------------------------
+// Main Enry Point
+//----------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : 100000;
+    int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+    int threads = (argc > 3) ? atoi(argv[3]) : 1;
+    int spatial = (argc > 4) ? atoi(argv[4]) : 0;
+    if (count < 1 || repeats < 1 || threads < 1) {
+        fprintf(stderr, "usage: %s [entities] [repeats] [threads] [spatial]\n", argv[0]);
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    entity_set_threads(threads);
+    entity_set_spatial(spatial != 0);
+
+    ids = (entity_id_t*)MemAlloc(count*sizeof(entity_id_t));
+    parents = (int*)MemAlloc(count*sizeof(int));
+    if (!ids || !parents) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory to run benchmark!"));
+        exit(1);
+    }
+    clip = entity_clip_create(count, 2);
+    for (int i = 0; i < count; i++) {
+        entity_clip_set_key(clip, i, 0, (Vector3){0.f, 0.f, 1.f}, QuaternionIdentity(), Vector3One());
+        entity_clip_set_key(clip, i, 1, (Vector3){0.f, 0.f, 1.f}, QuaternionFromEuler(0.f, PI/2, 0.f), Vector3One());
+    }
+
+    double index[SHAPE_COUNT][OP_COUNT];
+    printf("{\n  \"entities\": %i,\n  \"repeats\": %i,\n  \"threads\": %i,\n  \"spatial\": %i,\n  \"unit\": \"ns/entity\",\n  \"results\": {\n", count, repeats, threads, spatial);
+    for (int s = 0; s < SHAPE_COUNT; s++) {
+        double best[OP_COUNT];
+        for (int o = 0; o < OP_COUNT; o++) best[o] = index[s][o] = -1.0;
+
+        bench_shape((bench_shape_t)s, count);
+        for (int r = 0; r < repeats; r++) bench_run(count, best, index[s]);
+
+        printf("    \"%s\": {", bench_shapes[s]);
+        for (int o = 0; o < OP_COUNT; o++) printf("%s\"%s\": %.2f", (o) ? ", " : " ", bench_ops[o], best[o]*1e9/count);
+        printf(" }%s\n", (s + 1 < SHAPE_COUNT) ? "," : "");
+    }
+    printf("  }");
+    if (spatial) {
+        printf(",\n  \"index\": {\n");
+        for (int s = 0; s < SHAPE_COUNT; s++) {
+            printf("    \"%s\": {", bench_shapes[s]);
+            for (int o = 0, first = 1; o < OP_COUNT; o++) {
+                if (index[s][o] < 0.0) continue;
+                printf("%s\"%s\": %.2f", (first) ? " " : ", ", bench_ops[o], index[s][o]*1e9/count);
+                first = 0;
+            }
+            printf(" }%s\n", (s + 1 < SHAPE_COUNT) ? "," : "");
+        }
+        printf("  }");
+    }
+    printf("\n}\n");
+    remove(BENCH_SCENE);
+
+    entity_set_spatial(false);
+    entity_set_threads(1);
+    entity_clip_destroy(clip);
+    MemFree(parents);
+    MemFree(ids);
+
+    return 0;
+}
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition
+//----------------------------------------------------------------------------------
+
+// monotonic time in seconds
+double bench_now(void) {
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+unsigned int bench_rand(void) {
+    seed = seed*1103515245 + 12345;
+    return seed >> 8;
+}
+
+// fill parents with a hierarchy, every parent comes before its children
+void bench_shape(bench_shape_t shape, int count) {
+    seed = 1;
+    for (int i = 0; i < count; i++) {
+        switch (shape) {
+            case SHAPE_CHAIN: parents[i] = (i%BENCH_CHAIN_DEPTH) ? i - 1 : -1; break;
+            case SHAPE_FAN: parents[i] = (i) ? 0 : -1; break;
+            case SHAPE_TREE4: parents[i] = (i) ? (i - 1)/4 : -1; break;
+            default: parents[i] = (i && bench_rand()%16) ? (int)(bench_rand()%i) : -1; break;
+        }
+    }
+}
+
+// time every operation on the hierarchy once, keep the best time of each, and of the spatial
+// index update within each world pass
+void bench_run(int count, double *best, double *index) {
+    double t[OP_COUNT + 1], spent[OP_COUNT];
+    for (int o = 0; o < OP_COUNT; o++) spent[o] = -1.0;
+
+    t[OP_CREATE] = bench_now();
+    for (int i = 0; i < count; i++) ids[i] = create_entity();
+
+    t[OP_SET_PARENT] = bench_now();
+    for (int i = 0; i < count; i++) if (parents[i] >= 0) entity_set_parent(ids[i], ids[parents[i]]);
+
+    t[OP_WORLD_BUILD] = bench_now();
+    entity_update_world_all();
+    spent[OP_WORLD_BUILD] = entity_get_stats().spatial_time;
+
+    t[OP_TURN] = bench_now();
+    for (int i = 0; i < count; i++) turn_entity(ids[i], 0.f, 1.f, 0.f, TFORM_LOCAL);
+
+    t[OP_WORLD_TURN] = bench_now();
+    entity_update_world_all();
+    spent[OP_WORLD_TURN] = entity_get_stats().spatial_time;
+
+    t[OP_MOVE] = bench_now();
+    for (int i = 0; i < count; i++) move_entity(ids[i], 0.f, 0.f, 0.01f);
+
+    t[OP_WORLD_MOVE] = bench_now();
+    entity_update_world_all();
+    spent[OP_WORLD_MOVE] = entity_get_stats().spatial_time;
+
+    t[OP_SPAWN] = bench_now();
+    for (int i = 0; i < count; i++) move_entity(ids[i], 3.f, 0.f, 0.f);
+    entity_id_t spawn = create_entity();
+
+    t[OP_WORLD_SPAWN] = bench_now();
+    entity_update_world_all();
+    spent[OP_WORLD_SPAWN] = entity_get_stats().spatial_time;
+
+    t[OP_GET_WORLD] = bench_now();
+    for (int i = 0; i < count; i++) sink += entity_get_tform(ids[i], TFORM_WORLD).m12;
+
+    t[OP_WORLD_LAZY] = bench_now();
+    for (int i = 0; i < count; i++) if (parents[i] < 0) turn_entity(ids[i], 0.f, 1.f, 0.f, TFORM_LOCAL);
+    for (int i = 0; i < count; i++) sink += entity_get_tform(ids[i], TFORM_WORLD).m12;
+
+    // tracks are bound to this run's entities outside of the timings
+    double lazy_end = bench_now();
+    for (int i = 0; i < count; i++) entity_clip_bind(clip, i, ids[i]);
+    float time = 0.5f;
+
+    t[OP_ANIMATE] = bench_now();
+    entity_animate(&clip, &time, 1);
+
+    t[OP_WORLD_ANIMATE] = bench_now();
+    entity_update_world_all();
+    spent[OP_WORLD_ANIMATE] = entity_get_stats().spatial_time;
+
+    // the hierarchy is saved outside of the timings, loaded back once freed
+    double animate_end = bench_now();
+    entity_save_scene(BENCH_SCENE, ENTITY_NONE);
+
+    t[OP_FREE] = bench_now();
+    for (int i = 0; i < count; i++) if (parents[i] < 0) free_entity(ids[i]);
+
+    t[OP_LOAD_SCENE] = bench_now();
+    entity_id_t root = entity_load_scene(BENCH_SCENE, ENTITY_NONE);
+
+    t[OP_WORLD_LOAD] = bench_now();
+    entity_update_world_all();
+    spent[OP_WORLD_LOAD] = entity_get_stats().spatial_time;
+
+    t[OP_COUNT] = bench_now();
+    free_entity(spawn);
+    while (root) {
+        entity_id_t next = entity_get_successor(root);
+        free_entity(root);
+        root = next;
+    }
+    for (int o = 0; o < OP_COUNT; o++) {
+        double dt = ((o == OP_WORLD_LAZY) ? lazy_end : (o == OP_WORLD_ANIMATE) ? animate_end : t[o + 1]) - t[o];
+        if (best[o] < 0.0 || dt < best[o]) best[o] = dt;
+        if (spent[o] >= 0.0 && (index[o] < 0.0 || spent[o] < index[o])) index[o] = spent[o];
+    }
+}
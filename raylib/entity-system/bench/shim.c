@@ -0,0 +1,94 @@
+/*******************************************************************************************
+*
+*   entity: raylib shims of the headless benchmark
+*
+*   The few raylib functions the entity core calls (memory, logging, text formatting and file
+*   data), so that the benchmark builds without raylib and its window and draw code; raymath
+*   is used header only (RAYMATH_HEADER_ONLY)
+*
+*   Copyright (c) 2021 Christophe TES (@seyhajin)
+*
+********************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "raylib.h"
+
+#define SHIM_TEXT_BUFFERS   4       // TextFormat results valid at once, as in raylib
+#define SHIM_TEXT_LENGTH    1024
+
+//--------------------------------------
+// Global Variables Definition
+//--------------------------------------
+static int log_level = LOG_INFO;
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition
+//----------------------------------------------------------------------------------
+
+void *MemAlloc(int size) {
+    return calloc(size, 1);
+}
+
+void *MemRealloc(void *ptr, int size) {
+    return realloc(ptr, size);
+}
+
+void MemFree(void *ptr) {
+    free(ptr);
+}
+
+void SetTraceLogLevel(int logType) {
+    log_level = logType;
+}
+
+void TraceLog(int logType, const char *text, ...) {
+    static const char *prefix[] = {"", "TRACE: ", "DEBUG: ", "INFO: ", "WARNING: ", "ERROR: ", "FATAL: ", ""};
+    if (logType < log_level || logType < LOG_ALL || logType > LOG_FATAL) return;
+    va_list args;
+    va_start(args, text);
+    fputs(prefix[logType], stderr);
+    vfprintf(stderr, text, args);
+    fputc('\n', stderr);
+    va_end(args);
+    if (logType == LOG_FATAL) exit(1);
+}
+
+const char *TextFormat(const char *text, ...) {
+    static char buffers[SHIM_TEXT_BUFFERS][SHIM_TEXT_LENGTH];
+    static int index = 0;
+    char *buffer = buffers[index];
+    index = (index + 1)%SHIM_TEXT_BUFFERS;
+    va_list args;
+    va_start(args, text);
+    vsnprintf(buffer, SHIM_TEXT_LENGTH, text, args);
+    va_end(args);
+    return buffer;
+}
+
+unsigned char *LoadFileData(const char *fileName, unsigned int *bytesRead) {
+    unsigned char *data = NULL;
+    *bytesRead = 0;
+    FILE *file = fopen(fileName, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0 && (data = (unsigned char*)malloc(size))) *bytesRead = (unsigned int)fread(data, 1, size, file);
+    fclose(file);
+    return data;
+}
+
+void UnloadFileData(unsigned char *data) {
+    free(data);
+}
+
+bool SaveFileData(const char *fileName, void *data, unsigned int bytesToWrite) {
+    FILE *file = fopen(fileName, "wb");
+    if (!file) return false;
+    bool saved = fwrite(data, 1, bytesToWrite, file) == bytesToWrite;
+    fclose(file);
+    return saved;
+}
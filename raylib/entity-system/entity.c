@@ -1,500 +1,3633 @@
 /*******************************************************************************************
 *
-*   raylib: quadtree (adapted for HTML5 platform)
-*
-*   This example is prepared to compile for PLATFORM_WEB, PLATFORM_DESKTOP and PLATFORM_RPI
-*   As you will notice, code structure is slightly diferent to the other examples...
-*   To compile it for PLATFORM_WEB just uncomment #define PLATFORM_WEB at beginning
+*   entity: simple entity system, hierarchy and transforms of raylib entities
 *
 *   This example has been created using raylib 3.7 (www.raylib.com)
 *   raylib is licensed under an unmodified zlib/libpng license (View raylib.h for details)
 *
-*   Copyright (c) 2015 Ramon Santamaria (@raysan5)
 *   Copyright (c) 2021 Christophe TES (@seyhajin)
 *
 ********************************************************************************************/
 
+#if !defined(_POSIX_C_SOURCE) && !defined(_WIN32)
+    #define _POSIX_C_SOURCE 200112L     // clock_gettime
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
+#include <time.h>
+
+#include "entity.h"
 
-#include "raylib.h"
-#include "raymath.h"
+// transform kernels use the widest instruction set enabled at compile time (-msse2, -mavx2)
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define TFORM_LANES 8
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+    #define TFORM_LANES 4
+#else
+    #define TFORM_LANES 1
+#endif
 
-//#define PLATFORM_WEB
+// parallel transform propagation (entity_set_threads), define ENTITY_NO_THREADS to opt out
+#if !defined(ENTITY_NO_THREADS) && !defined(PLATFORM_WEB) && !defined(__EMSCRIPTEN__) && !defined(_MSC_VER)
+    #define ENTITY_THREADS
+    #include <pthread.h>
+    #include <sched.h>
+    #include <stdatomic.h>
+#endif
 
-#if defined(PLATFORM_WEB)
-    #include <emscripten/emscripten.h>
+// scene files are mapped in memory when loaded (entity_load_scene), define ENTITY_NO_MMAP to read them instead
+#if !defined(ENTITY_NO_MMAP) && (defined(__unix__) || defined(__APPLE__)) && !defined(PLATFORM_WEB) && !defined(__EMSCRIPTEN__)
+    #define ENTITY_MMAP
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
 #endif
 
 //--------------------------------------
 // types/structures declaration
 //--------------------------------------
 
-typedef enum tform_space_e {
-    TFORM_LOCAL = 0,
-    TFORM_WORLD = 1,
-} tform_space_t;
-
 typedef enum tform_dirty_e {
-    TFORM_DIRTY_LOCAL=1,
-    TFORM_DIRTY_WORLD=2
+    TFORM_DIRTY_WORLD=1,
+    TFORM_DIRTY_QUEUED=2,    // transform is a dirty root, waiting for the next propagation pass
+    TFORM_DIRTY_BOUNDS=4,    // subtree box waiting to be rebuilt from the children (within a pass only)
+    TFORM_STATIC=8,          // world matrix baked by entity_set_static, never recomputed nor written
+    TFORM_TREE_UNBOUNDED=16, // the subtree holds an unbounded entity, maintained along with tree_box
+    TFORM_INVERSE_CACHED=32  // world inverse held by the inverse cache, cleared by every world matrix write
 } tform_dirty_t;
 
-typedef struct tform_s {
-    Quaternion rot;
-    Vector3 pos, scale;
-    Matrix mat;
-} tform_t;
+// transform store: structure of arrays, index 0 is unused and transforms are kept in hierarchy
+// pre-order, so every parent is stored before its children and every subtree is a contiguous range;
+// local matrices are not kept, they are composed from pos/rot/scale when needed, and world inverses
+// are only cached for the few entities asked for them (tform_inverse_cache_t)
+typedef struct tform_store_s {
+    // hot: read or written by every propagation pass
+    Vector3 *pos, *scale;
+    Quaternion *rot;
+    Matrix *world;
+    uint32_t *parent;   // store index of the parent transform, 0 for roots
+    uint32_t *size;     // transforms in the subtree, itself included (valid while sorted)
+    uint8_t *dirty;
+    // cold: getters, culling and bookkeeping
+    Quaternion *world_rot;  // resolved along with the world matrix
+    Vector3 *world_scale;
+    Vector4 *bounds;        // local bounding sphere: center xyz, radius w (0 if unbounded, never culled)
+    BoundingBox *tree_box;  // world box of the bounded entities of the subtree, empty (min > max) if none,
+                            // unbounded ones are flagged apart (TFORM_TREE_UNBOUNDED)
+    uint32_t *owner;    // entity slot owning the transform, ENTITY_NONE for a freed transform
+    uint32_t count, capacity;
+    bool sorted;        // false when pre-order or compactness was broken
+} tform_store_t;
+
+// bytes of one transform across the arrays of tform_store_t
+#define TFORM_BYTES     (3*sizeof(Vector3) + 2*sizeof(Quaternion) + sizeof(Matrix) + sizeof(Vector4) + \
+                         sizeof(BoundingBox) + 3*sizeof(uint32_t) + sizeof(uint8_t))
+
+#define TFORM_STORE_MIN     256
+#define TFORM_INVERSE_CACHE 1024    // world inverses cached at once, a power of 2
+#define TFORM_CHUNK         64      // local matrices composed at once by tform_update_range, on its stack
+#define TFORM_SPLICE_MAX    256     // longest store span moved on a structural change, longer ones wait for tform_sort
+#define TFORM_TASK_GRAIN    512     // transforms resolved by a worker before it splits work off
+
+// world inverses asked for by world space setters (of the parents of their entities), computed on
+// demand and kept direct mapped on the entity slot: an entry is valid while its slot matches and the
+// transform holds TFORM_INVERSE_CACHED, so no store array pays for entities never asked for theirs
+typedef struct tform_inverse_cache_s {
+    Matrix *inv;
+    uint32_t *slot;     // entity slot of each entry, ENTITY_NONE if empty
+} tform_inverse_cache_t;
+
+// a run of consecutive whole subtrees of the store whose parents are already resolved
+typedef struct tform_task_s {
+    uint32_t begin, end;
+} tform_task_t;
+
+// subtrees invalidated since the last propagation pass, setters only record their root
+typedef struct tform_dirty_set_s {
+    uint32_t *roots;        // entity handles, stale ones are skipped
+    tform_task_t *ranges;   // store ranges of the roots, rebuilt by each pass
+    uint32_t *path;         // scratch for lazy world resolution and subtree boxes
+    uint32_t *reshaped;     // entity handles whose subtree lost children, their box is rebuilt by the next pass
+    uint32_t count, capacity, path_capacity;
+    uint32_t resolved;      // roots whose ranges a world read already resolved, they stay queued for their bounds
+    uint32_t reshaped_count, reshaped_capacity;
+} tform_dirty_set_t;
+
+// scratch of entity_cull: world bounding spheres of the candidates, as arrays for the plane tests
+typedef struct tform_cull_s {
+    float *x, *y, *z, *r;
+    uint32_t *slot;     // entity slot of each sphere
+    uint8_t *in;        // 1 if the sphere intersects the frustum
+    uint32_t capacity;
+} tform_cull_t;
+
+// scratch of point_entities/align_entities: world direction and rotation of each entity, as arrays for the kernels
+typedef struct tform_aim_s {
+    float *dx, *dy, *dz;        // direction to aim at, not normalized
+    float *qx, *qy, *qz, *qw;   // world rotation, current on input, aimed on output
+    entity_id_t *id;
+    uint32_t capacity;
+} tform_aim_t;
+
+// dynamic bounding volume hierarchy over the entity world bounding spheres (entity_set_spatial),
+// leaves keep a fattened box so that small moves leave the tree untouched
+typedef struct bvh_node_s {
+    BoundingBox box;    // union of the children, fattened world box for leaves
+    Vector4 sphere;     // leaves: world bounding sphere of the entity
+    uint32_t parent, left, right;   // node indices, 0 if unset (right links free nodes)
+    uint32_t owner;     // leaves: entity slot, ENTITY_NONE for inner nodes
+    int height;         // 0 for leaves
+} bvh_node_t;
+
+// leaf taken by a rebuild, with its center packed for the splits
+typedef struct bvh_item_s {
+    Vector3 center;
+    uint32_t node;
+} bvh_item_t;
+
+typedef struct bvh_tree_s {
+    bvh_node_t *nodes;  // node 0 is unused
+    uint32_t count, capacity, free_head, root;
+    uint32_t *stack;    // traversal scratch
+    uint32_t stack_capacity;
+    uint32_t *moved;    // leaves new or out of their fattened box during a refit
+    uint32_t moved_count, moved_capacity;
+    uint32_t *inner;    // refit scratch, inner nodes in pre-order
+    uint32_t inner_capacity;
+    bvh_item_t *items;  // rebuild scratch
+    uint32_t item_capacity;
+    uint32_t leaves;    // allocated leaves, in the tree or about to join it
+    float area;         // surface area of the inner nodes over the root one after the last rebuild
+    bool enabled;
+} bvh_tree_t;
+
+typedef bool (*bvh_test_t)(const bvh_node_t *n, const void *arg);
+
+#define BVH_NODES_MIN   256
+#define BVH_MARGIN      0.1f    // fattening of leaf boxes, plus 10% of the sphere radius
+#define BVH_PREDICT     4.f     // leaf boxes are also stretched along the last move, times this factor
+#define BVH_REINSERT    64      // moved leaves are reinserted one by one while at most 1 in this many
+#define BVH_DECAY       2.f     // in place refits rebuild the tree once its relative inner area grows this much
+
+// packed set of entity slots with O(1) insert/remove, order is arbitrary
+typedef struct entity_set_s {
+    uint32_t *items;    // entity slots
+    uint32_t *at;       // position + 1 of each entity slot in items, 0 when absent
+    uint32_t count, capacity, slots;
+} entity_set_t;
+
+typedef enum entity_cmd_op_e {
+    ENTITY_CMD_CREATE = 0,
+    ENTITY_CMD_FREE,
+    ENTITY_CMD_SET_PARENT,
+    ENTITY_CMD_POSITION,
+    ENTITY_CMD_ROTATE,
+    ENTITY_CMD_TURN,
+    ENTITY_CMD_SCALE,
+    ENTITY_CMD_MOVE
+} entity_cmd_op_t;
+
+// recorded operation, rotations are converted to a quaternion by the recording thread
+typedef struct entity_cmd_s {
+    uint8_t op, global;
+    entity_id_t e, p;   // target and new parent, pending handles of the same buffer are allowed
+    Vector4 v;          // position, scale or move xyz, or rotation quaternion
+} entity_cmd_t;
+
+// command buffer owned by a single thread, entity_cmds_apply replays it on the main thread
+struct entity_cmds_s {
+    entity_cmd_t *items;
+    uint32_t count, capacity;
+    uint32_t created;       // pending handles given out since the last apply
+    entity_id_t *resolved;  // handles of the entities created by the last apply, by pending index
+    uint32_t resolved_capacity;
+};
+
+#define ENTITY_CMDS_MIN     64
+
+// read-only copy of the world matrices published by entity_publish, indexed by entity slot
+struct entity_snapshot_s {
+    Matrix *world;
+    uint32_t *gen;      // generation of each slot when published, 0 for a free slot
+    uint32_t slots, capacity;
+    uint64_t frame;
+#if defined(ENTITY_THREADS)
+    atomic_int readers; // threads between entity_snapshot_acquire and entity_snapshot_release
+#else
+    int readers;
+#endif
+};
+
+// one snapshot is current, the others are recycled once their last reader is gone
+#define ENTITY_SNAPSHOTS    3
+
+typedef struct entity_snapshots_s {
+    entity_snapshot_t buffers[ENTITY_SNAPSHOTS];
+#if defined(ENTITY_THREADS)
+    _Atomic(entity_snapshot_t*) current;
+#else
+    entity_snapshot_t *current;
+#endif
+    uint64_t frame;
+} entity_snapshots_t;
+
+// keyframe channels of a clip, each stored as [key][track] so a sample walks every track linearly
+typedef enum clip_channel_e {
+    CLIP_PX = 0, CLIP_PY, CLIP_PZ,
+    CLIP_RX, CLIP_RY, CLIP_RZ, CLIP_RW,
+    CLIP_SX, CLIP_SY, CLIP_SZ,
+    CLIP_CHANNELS
+} clip_channel_t;
+
+// entity of a tick group other than ENTITY_TICK_ALWAYS, with its last two resolved world transforms
+typedef struct entity_tick_rec_s {
+    entity_id_t id;
+    uint8_t group, phase;
+    uint8_t period;     // frames between the two records
+    bool due;           // to be updated this frame
+    uint32_t frame;     // frame of the last record
+    Vector3 pos[2], scale[2];   // previous and last
+    Quaternion rot[2];
+} entity_tick_rec_t;
+
+typedef struct entity_ticks_s {
+    entity_tick_rec_t *items;
+    uint32_t *at;       // position + 1 of each entity slot in items, 0 for an entity ticking every frame
+    uint32_t count, capacity, slots;
+    uint32_t joined[ENTITY_TICK_GROUPS];    // entities ever added to each group, staggers their phases
+    uint32_t frame;
+    Vector3 camera;
+    float half, quarter;    // distances from which ENTITY_TICK_DISTANCE entities tick every 2nd, 4th frame
+} entity_ticks_t;
+
+struct entity_clip_s {
+    int tracks, keys;
+    float *times;           // key times, shared by all tracks, increasing
+    float *channels;        // CLIP_CHANNELS blocks of keys*tracks values
+    float *sample;          // last sample, CLIP_CHANNELS rows of tracks values
+    entity_id_t *targets;   // entity driven by each track, ENTITY_NONE if unbound
+    uint64_t *order;        // store index << 32 | track, tracks are written parents first
+};
+
+#if defined(ENTITY_THREADS)
+#define ENTITY_MAX_THREADS  64
+
+// work-stealing deque: the owner pushes and pops at the bottom, thieves steal from the top
+typedef struct tform_worker_s {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    tform_task_t *tasks;
+    uint32_t top, bottom, capacity; // capacity is a power of two, top/bottom wrap around
+    uint32_t seed;
+} tform_worker_t;
+
+typedef struct tform_jobs_s {
+    tform_worker_t workers[ENTITY_MAX_THREADS]; // worker 0 is the calling thread
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    uint32_t round;     // bumped to start a propagation round
+    bool quit;
+    atomic_int pending; // tasks queued or running in the current round
+} tform_jobs_t;
+#endif
+
+#define ENTITY_INDEX_BITS   20
+#define ENTITY_INDEX_MASK   ((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_GEN_MASK     ((1u << (32 - ENTITY_INDEX_BITS)) - 1)
+#define ENTITY_POOL_MIN     256
 
+// hot entity data, read by every handle resolution and hierarchy walk, everything else lives in entity_cold_t
 typedef struct entity_s {
-    struct entity_s *parent, *children, *succ, *pred, *last_child;
-    bool visible, enabled;
-    const char *name;
-    tform_dirty_t dirty;
-    tform_t local;
-    tform_t world;
+    uint32_t parent, children, succ; // slot indices, ENTITY_NONE if unset (succ links free slots)
+    uint32_t gen;
+    uint32_t tf;        // transform store index, 0 while the slot is free
 } entity_t;
 
-static entity_t *entity_orphans = NULL;
-static entity_t *entity_last_orphan = NULL;
+// cold entity data, same slot index as the hot data
+typedef struct entity_cold_s {
+    uint32_t pred, last_child;  // slot indices, only needed to link and unlink
+    uint32_t leaf;      // spatial index leaf, 0 if not indexed
+    bool visible, enabled;
+    const char *name;
+} entity_cold_t;
+
+// size budgets (per entity: hot slot, cold slot, and all of it with its transform and its place in the
+// visible and enabled sets, the spatial index aside), checked at compile time; the total (245 bytes) does
+// not halve the former ~300: the slots and sets take 60, the transform 185, of which 68 are world
+// rotation and scale, local bounds and subtree box, kept for the getters, culling and the spatial index
+#define ENTITY_STATIC_ASSERT(cond, name) typedef char name[(cond) ? 1 : -1]
+ENTITY_STATIC_ASSERT(sizeof(entity_t) <= 20, entity_hot_fits_20_bytes);
+ENTITY_STATIC_ASSERT(sizeof(entity_cold_t) <= 16 + sizeof(const char*), entity_cold_fits_16_bytes_and_name);
+ENTITY_STATIC_ASSERT(sizeof(entity_t) + sizeof(entity_cold_t) + TFORM_BYTES + 4*sizeof(uint32_t) <= 248, entity_fits_248_bytes);
+
+typedef struct entity_pool_s {
+    entity_t *slots;
+    entity_cold_t *cold;
+    uint32_t count;     // slots in use or on the free list (slot 0 included)
+    uint32_t capacity;
+    uint32_t free_head; // first recycled slot, ENTITY_NONE if empty
+} entity_pool_t;
+
+#define ENTITY_COLD(e)  (&entity_pool.cold[(e) - entity_pool.slots])
+
+// interned names: each distinct text is copied once into blocks that never move, so equal names share
+// one pointer; the table hashes the texts (open addressing, capacity a power of 2)
+typedef struct entity_names_s {
+    const char **table;
+    uint32_t count, capacity;
+    char *block;        // current block, the first bytes link the previous one
+    uint32_t used, size;
+} entity_names_t;
+
+#define ENTITY_NAMES_BLOCK  4096
+
+// named entities indexed by (parent slot, interned name), the key is read back from the entity so the
+// table only keeps slots (0 for empty); linear probing with backward shift deletion
+typedef struct entity_lookup_s {
+    uint32_t *slots;
+    uint32_t count, capacity;
+} entity_lookup_t;
+
+// scene file (little endian): the header, then one array per field of the flattened hierarchy in pre-order,
+// laid out as in the transform store so that adopting it is mostly block copies; every array starts on 16 bytes
+typedef struct entity_scene_header_s {
+    uint32_t magic;     // ENTITY_SCENE_MAGIC
+    uint32_t version;   // ENTITY_SCENE_VERSION
+    uint32_t count;     // entities
+    uint32_t names;     // bytes of the name table
+    uint32_t size;      // bytes of the whole file
+    uint32_t reserved[3];
+} entity_scene_header_t;
+
+typedef enum entity_scene_array_e {
+    SCENE_POS = 0,      // Vector3, local
+    SCENE_ROT,          // Quaternion, local
+    SCENE_SCALE,        // Vector3, local
+    SCENE_BOUNDS,       // Vector4, local bounding sphere
+    SCENE_PARENT,       // uint32_t, file index of the parent + 1 (always before the entity), 0 for a root
+    SCENE_NAME,         // uint32_t, offset in the name table + 1, 0 if unnamed
+    SCENE_FLAGS,        // uint8_t, entity_scene_flag_t
+    SCENE_NAMES,        // name table, NUL-terminated texts, each distinct name once
+    SCENE_ARRAYS
+} entity_scene_array_t;
+
+typedef enum entity_scene_flag_e {
+    SCENE_VISIBLE = 1,
+    SCENE_ENABLED = 2,
+    SCENE_STATIC = 4
+} entity_scene_flag_t;
+
+#define ENTITY_SCENE_MAGIC      0x53544e45  // "ENTS"
+#define ENTITY_SCENE_VERSION    1
+
+// the arrays are written and read in the host layout, so scene files are refused on big endian hosts
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    #define ENTITY_SCENE_BIG_ENDIAN
+#endif
 
-//--------------------------------------
-// public entity functions declaration
-//--------------------------------------
-entity_t *create_entity();
-entity_t *copy_entity(const entity_t *e);
-void free_entity(entity_t *e);
-
-void entity_set_parent(entity_t *e, entity_t *p);
-void entity_set_name(entity_t *e, const char *name);
-void entity_set_visible(entity_t *e, bool visible);
-void entity_set_enabled(entity_t *e, bool enabled);
-entity_t *entity_get_parent(entity_t *e);
-const char *entity_get_name(entity_t *e);
-entity_t *entity_get_children(entity_t *e);
-entity_t *entity_get_successor(entity_t *e);
-
-// entity transform functions
-void entity_set_position(entity_t *e, Vector3 pos, tform_space_t global);
-void entity_set_scale(entity_t *e, Vector3 scale, tform_space_t global);
-void entity_set_rotation(entity_t *e, Quaternion rot, tform_space_t global);
-Vector3 entity_get_position(entity_t *e, tform_space_t global);
-Vector3 entity_get_scale(entity_t *e, tform_space_t global);
-Quaternion entity_get_rotation(entity_t *e, tform_space_t global);
-
-void move_entity(entity_t *e, float x, float y, float z);
-void turn_entity(entity_t *e, float p, float y, float r, tform_space_t global);
-void translate_entity(entity_t *e, float x, float y, float z, tform_space_t global);
-void position_entity(entity_t *e, float x, float y, float z, tform_space_t global);
-void scale_entity(entity_t *e, float x, float y, float z, tform_space_t global);
-void rotate_entity(entity_t *e, float p, float y, float r, tform_space_t global);
-void point_entity(entity_t *e, entity_t *t, float roll);
-void align_entity(entity_t *e, float nx, float ny, float nz, int axis, float rate);
-
-//void entity_enum_visible(entity_t *e, vector<entity_t*> &out); //TODO: need list
-//void entity_enum_enabled(entity_t *e, vector<entity_t*> &out); //TODO: need list
+static entity_pool_t entity_pool = {0};
+static uint32_t entity_orphans = ENTITY_NONE;
+static uint32_t entity_last_orphan = ENTITY_NONE;
+static entity_names_t entity_names = {0};
+static entity_lookup_t entity_lookup = {0};
+static entity_ticks_t entity_ticks = {0};
+static tform_store_t entity_tforms = {0};
+static tform_dirty_set_t entity_dirty = {0};
+static tform_inverse_cache_t entity_inverses = {0};
+static entity_stats_t entity_stats = {0};
+static tform_cull_t entity_culling = {0};
+static tform_aim_t entity_aiming = {0};
+static bvh_tree_t entity_bvh = {0};
+static entity_set_t entity_visible = {0};  // entities visible along with all their ancestors
+static entity_set_t entity_enabled = {0};  // entities enabled along with all their ancestors
+static entity_snapshots_t entity_snapshots = {0};
+#if defined(ENTITY_THREADS)
+static tform_jobs_t entity_jobs = {0};
+#endif
 
 //--------------------------------------
 // private entity functions declaration
 //--------------------------------------
+entity_t *entity_get(entity_id_t e);
+entity_id_t entity_handle(const entity_t *e);
+uint32_t entity_alloc();
+void entity_reserve(uint32_t count);
+void entity_release(entity_t *e);
 void entity_insert(entity_t *e);
 void entity_remove(entity_t *e);
-void entity_invalidate_tform(entity_t *e, tform_space_t global);
-void entity_set_tform(entity_t *e, Matrix mat, tform_space_t global);
-Matrix entity_get_tform(entity_t *e, tform_space_t global);
+void entity_invalidate_tform(entity_t *e);
+void entity_turn(entity_id_t e, Quaternion rot, tform_space_t global);
+void entity_refresh_sets(entity_t *e);
+void entity_join_sets(uint32_t i);
+bool entity_frozen(const entity_t *e);
+bool entity_resting(const entity_t *e);
+double entity_now();
+const char *entity_intern(const char *text, size_t len, bool add);
+uint32_t entity_name_slot(const char *name);
+uint32_t entity_lookup_home(uint32_t parent, const char *name);
+void entity_lookup_add(uint32_t i);
+void entity_lookup_del(uint32_t i);
+uint32_t entity_lookup_find(uint32_t parent, const char *path);
+uint32_t entity_scene_layout(uint32_t count, uint32_t names, uint32_t *offset);
+void entity_set_add(entity_set_t *set, uint32_t i);
+void entity_set_del(entity_set_t *set, uint32_t i);
+int entity_set_enum(const entity_set_t *set, entity_id_t e, entity_id_t *out, int max);
+entity_cmd_t *entity_cmd_push(entity_cmds_t *c, entity_cmd_op_t op, entity_id_t e);
+void entity_cmds_run(entity_cmds_t *c, uint32_t begin, uint32_t end);
+void clip_sample(entity_clip_t *clip, float time);
+void clip_write(entity_clip_t *clip);
+entity_tick_rec_t *entity_tick_rec(uint32_t i);
+void entity_tick_record(entity_tick_rec_t *r);
+uint32_t tform_alloc(uint32_t owner);
+uint32_t tform_append_block(uint32_t n);
+void tform_reserve(tform_store_t *s, uint32_t capacity);
+void tform_release(uint32_t t);
+void tform_sort();
+void tform_permute(tform_store_t *s, uint32_t *src, uint32_t begin, uint32_t end);
+void tform_move(tform_store_t *s, uint32_t dst, uint32_t src);
+void tform_move_range(tform_store_t *s, uint32_t dst, uint32_t src, uint32_t n);
+bool tform_splice(uint32_t t, uint32_t p);
+bool tform_cut(uint32_t t);
+Matrix tform_local(uint32_t t);
+Matrix tform_world(uint32_t t);
+void tform_resolve_pending();
+void tform_combine(tform_store_t *s, uint32_t t, const Matrix *local);
+Matrix tform_world_inverse(uint32_t t);
+Matrix tform_affine_inverse(Matrix mat);
+Matrix tform_compose(Vector3 pos, Quaternion rot, Vector3 scale);
+Matrix tform_multiply(Matrix left, Matrix right);
+void tform_compose_batch(tform_store_t *s, const uint32_t *idx, int n, Matrix *out);
+void tform_update_range(uint32_t begin, uint32_t end);
+Vector4 tform_world_bounds(uint32_t t);
+Vector4 tform_sphere(Vector4 bounds, const Matrix *world);
+BoundingBox tform_own_box(tform_store_t *s, uint32_t t);
+void tform_cull_batch(tform_cull_t *c, const Vector4 *planes, uint32_t n);
+void tform_frustum(Matrix viewproj, Vector4 *planes);
+bool tform_box_visible(BoundingBox box, const Vector4 *planes);
+void tform_aim_reserve(tform_aim_t *a, uint32_t n);
+void tform_aim_write(tform_aim_t *a, uint32_t n);
+void tform_point_batch(tform_aim_t *a, uint32_t n, Quaternion roll, float rate);
+void tform_align_batch(tform_aim_t *a, uint32_t n, int axis, float rate);
+uint32_t tform_path_push(uint32_t n, uint32_t t);
+void tform_reshape(uint32_t p);
+void tform_update_bounds(const tform_task_t *ranges, uint32_t count);
+void tform_tree_box(tform_store_t *s, uint32_t t);
+uint32_t bvh_alloc();
+void bvh_release(uint32_t n);
+void bvh_insert(uint32_t leaf);
+void bvh_remove(uint32_t leaf);
+uint32_t bvh_balance(uint32_t a);
+bool bvh_fit_leaf(entity_t *e);
+void bvh_update(entity_t *e);
+void bvh_drop(entity_t *e);
+void bvh_reserve(uint32_t **list, uint32_t *capacity, uint32_t n);
+uint32_t bvh_build(const bvh_node_t *old, bvh_item_t *items, uint32_t n, Vector3 lo, Vector3 hi);
+void bvh_rebuild();
+float bvh_refit_all();
+void bvh_settle();
+void bvh_refit(const tform_task_t *ranges, uint32_t count);
+uint32_t *bvh_stack();
+int bvh_query(bvh_test_t test, const void *arg, entity_id_t *out, int max);
+#if defined(ENTITY_THREADS)
+void tform_jobs_run(const tform_task_t *ranges, uint32_t count);
+void *tform_jobs_main(void *arg);
+#endif
 
 //--------------------------------------
 // public entity functions definition
 //--------------------------------------
 
-entity_t *create_entity() {
-    entity_t *e = (entity_t*)MemAlloc(sizeof(entity_t));
-    if (e) {
-        e->parent = NULL;
-        e->children = NULL;
-        e->succ = NULL;
-        e->pred = NULL;
-        e->last_child = NULL;
-
-        e->visible = true;
-        e->enabled = true;
-        e->local.pos = Vector3Zero();
-        e->local.scale = Vector3One();
-        e->local.rot = QuaternionIdentity();
-        e->dirty = TFORM_DIRTY_LOCAL|TFORM_DIRTY_WORLD;
-        entity_insert(e);
-    } else {
-        TraceLog(LOG_ERROR, TextFormat("unable allocate memory to create new entity!"));
-        exit(1);
-    }
-    return e;
+entity_id_t create_entity() {
+    uint32_t i = entity_alloc();
+    entity_t *e = &entity_pool.slots[i];
+    entity_cold_t *c = &entity_pool.cold[i];
+    e->parent = ENTITY_NONE;
+    e->children = ENTITY_NONE;
+    e->succ = ENTITY_NONE;
+    c->pred = ENTITY_NONE;
+    c->last_child = ENTITY_NONE;
+
+    c->visible = true;
+    c->enabled = true;
+    c->name = NULL;
+    c->leaf = 0;
+    e->tf = tform_alloc(i);
+    entity_insert(e);
+    entity_invalidate_tform(e);
+    entity_set_add(&entity_visible, i);
+    entity_set_add(&entity_enabled, i);
+    return entity_handle(e);
 }
 
-entity_t *copy_entity(const entity_t *e) {
-    entity_t *cp = create_entity();
-    if (cp) {
-        cp->name = e->name;
-        cp->visible = e->visible;
-        cp->enabled = e->enabled;
-        cp->local.pos = e->local.pos;
-        cp->local.scale = e->local.scale;
-        cp->local.rot = e->local.rot;
-        cp->dirty = TFORM_DIRTY_LOCAL|TFORM_DIRTY_WORLD;
-    }
-    return cp;
+entity_id_t copy_entity(entity_id_t e) {
+    if (!entity_get(e)) return ENTITY_NONE;
+    entity_id_t id = create_entity(); // may grow the pool, resolve source afterwards
+    entity_t *src = entity_get(e);
+    entity_t *cp = entity_get(id);
+    entity_set_name(id, ENTITY_COLD(src)->name);
+    ENTITY_COLD(cp)->visible = ENTITY_COLD(src)->visible;
+    ENTITY_COLD(cp)->enabled = ENTITY_COLD(src)->enabled;
+    entity_refresh_sets(cp);
+    entity_tforms.pos[cp->tf] = entity_tforms.pos[src->tf];
+    entity_tforms.scale[cp->tf] = entity_tforms.scale[src->tf];
+    entity_tforms.rot[cp->tf] = entity_tforms.rot[src->tf];
+    entity_tforms.bounds[cp->tf] = entity_tforms.bounds[src->tf];
+    return id;
+}
+
+// an entity of the source range at t maps to the copy at the same offset in the range at c
+static inline uint32_t entity_instance_slot(uint32_t t, uint32_t c, uint32_t i) {
+    return (i) ? entity_tforms.owner[c + entity_pool.slots[i].tf - t] : ENTITY_NONE;
 }
 
-void free_entity(entity_t *e) {
-    while (e->children) {
-        MemFree(e->children);
-        e->children = NULL;
+// clone the whole subtree of src under parent (ENTITY_NONE for a root) in one go: the source is a store
+// range, the copy is appended as a block (slots and transforms reserved once, arrays copied with memcpy),
+// links are remapped through the store offsets and only the new root is flagged dirty
+entity_id_t instantiate_subtree(entity_id_t src, entity_id_t parent) {
+    entity_t *e = entity_get(src);
+    entity_t *pe = (parent) ? entity_get(parent) : NULL;
+    if (!e || (parent && !pe)) return ENTITY_NONE;
+    tform_store_t *s = &entity_tforms;
+    if (!s->sorted) tform_sort();
+    uint32_t p = (pe) ? (uint32_t)(pe - entity_pool.slots) : ENTITY_NONE;
+    uint32_t t = e->tf, n = s->size[t], c = tform_append_block(n);
+    memcpy(&s->pos[c], &s->pos[t], n*sizeof(Vector3));
+    memcpy(&s->scale[c], &s->scale[t], n*sizeof(Vector3));
+    memcpy(&s->rot[c], &s->rot[t], n*sizeof(Quaternion));
+    memcpy(&s->bounds[c], &s->bounds[t], n*sizeof(Vector4));
+    memcpy(&s->size[c], &s->size[t], n*sizeof(uint32_t));
+
+    bool baked = false;
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t i = s->owner[t + k], j = s->owner[c + k];
+        entity_t *from = &entity_pool.slots[i], *to = &entity_pool.slots[j];
+        entity_cold_t *cf = &entity_pool.cold[i], *ct = &entity_pool.cold[j];
+        to->parent = (k) ? entity_instance_slot(t, c, from->parent) : p;
+        to->children = entity_instance_slot(t, c, from->children);
+        to->succ = (k) ? entity_instance_slot(t, c, from->succ) : ENTITY_NONE;
+        to->tf = c + k;
+        ct->pred = (k) ? entity_instance_slot(t, c, cf->pred) : ENTITY_NONE;
+        ct->last_child = entity_instance_slot(t, c, cf->last_child);
+        ct->leaf = 0;
+        ct->visible = cf->visible;
+        ct->enabled = cf->enabled;
+        ct->name = cf->name;
+        if (k && ct->name) entity_lookup_add(j); // the root is indexed by entity_insert
+        s->parent[c + k] = (k) ? s->parent[t + k] - t + c : ((p) ? entity_pool.slots[p].tf : 0);
+        s->dirty[c + k] = 0;
+        baked |= (s->dirty[t + k] & TFORM_STATIC) != 0;
+        entity_join_sets(j);
+    }
+
+    // static copies bake the world matrix they get under parent now, like entity_adopt_scene
+    if (baked) {
+        if (p) tform_world(entity_pool.slots[p].tf);
+        tform_update_range(c, c + n);
+        for (uint32_t k = 0; k < n; k++) s->dirty[c + k] |= s->dirty[t + k] & TFORM_STATIC;
+    }
+
+    entity_t *root = &entity_pool.slots[s->owner[c]];
+    s->parent[c] = 0;
+    entity_insert(root);
+    if (p && !tform_splice(c, entity_pool.slots[p].tf)) {
+        s->parent[c] = entity_pool.slots[p].tf;
+        s->sorted = false;
     }
+    entity_invalidate_tform(root);
+    return entity_handle(root);
+}
+
+void free_entity(entity_id_t id) {
+    entity_t *e = entity_get(id);
+    if (!e) return;
+    tform_reshape(e->parent);
     entity_remove(e);
+
+    // the subtree is a contiguous store range: release it linearly, then close the gap
+    tform_store_t *s = &entity_tforms;
+    if (s->sorted) {
+        uint32_t t = e->tf;
+        for (uint32_t k = t; k < t + s->size[t]; k++) {
+            entity_t *n = &entity_pool.slots[s->owner[k]];
+            entity_set_del(&entity_visible, s->owner[k]);
+            entity_set_del(&entity_enabled, s->owner[k]);
+            bvh_drop(n);
+            entity_release(n);
+        }
+        if (!tform_cut(t)) for (uint32_t k = t; k < t + s->size[t]; k++) tform_release(k);
+        return;
+    }
+
+    // release the whole subtree, leaves first, without recursion
+    uint32_t root = e - entity_pool.slots, i = root;
+    for (;;) {
+        entity_t *n = &entity_pool.slots[i];
+        if (n->children) { i = n->children; continue; }
+        uint32_t p = n->parent;
+        if (i != root) entity_pool.slots[p].children = n->succ;
+        entity_set_del(&entity_visible, i);
+        entity_set_del(&entity_enabled, i);
+        bvh_drop(n);
+        tform_release(n->tf);
+        entity_release(n);
+        if (i == root) break;
+        i = p;
+    }
+}
+
+bool entity_is_valid(entity_id_t e) {
+    uint32_t i = e & ENTITY_INDEX_MASK;
+    return i != ENTITY_NONE && i < entity_pool.count && entity_pool.slots[i].gen == (e >> ENTITY_INDEX_BITS) && entity_pool.slots[i].tf;
 }
 
-void entity_set_parent(entity_t *e, entity_t *p) {
-    if (e->parent == p) return;
+void entity_set_parent(entity_id_t id, entity_id_t pid) {
+    entity_t *e = entity_get(id);
+    if (!e) return;
+    entity_t *pe = (pid) ? entity_get(pid) : NULL;
+    if (pid && !pe) return;
+    uint32_t p = (pe) ? pe - entity_pool.slots : ENTITY_NONE;
+    if (e->parent == p || entity_frozen(e)) return;
+    tform_reshape(e->parent);
     entity_remove(e);
     e->parent = p;
     entity_insert(e);
-    entity_invalidate_tform(e, TFORM_WORLD);
+    if (!entity_tforms.sorted || !tform_splice(e->tf, (pe) ? pe->tf : 0)) {
+        entity_tforms.parent[e->tf] = (pe) ? pe->tf : 0;
+        entity_tforms.sorted = false; // the moved subtree is no longer contiguous with its new parent
+    }
+    entity_invalidate_tform(e);
+    entity_refresh_sets(e);
+}
+
+// the text is interned (copied once per distinct name), entity_get_name returns the interned copy
+void entity_set_name(entity_id_t e, const char *name) {
+    entity_t *p = entity_get(e);
+    if (!p) return;
+    uint32_t i = p - entity_pool.slots;
+    if (ENTITY_COLD(p)->name) entity_lookup_del(i);
+    ENTITY_COLD(p)->name = (name && *name) ? entity_intern(name, strlen(name), true) : NULL;
+    if (ENTITY_COLD(p)->name) entity_lookup_add(i);
+}
+
+// entity at a '/' separated path of names below from (ENTITY_NONE: from the roots), e.g. "player/weapon/muzzle";
+// one hash lookup per segment whatever the scene size, siblings sharing a name are tried in turn
+entity_id_t entity_find(entity_id_t from, const char *path) {
+    uint32_t p = ENTITY_NONE;
+    if (from) {
+        entity_t *e = entity_get(from);
+        if (!e) return ENTITY_NONE;
+        p = e - entity_pool.slots;
+    }
+    if (!path) return ENTITY_NONE;
+    while (*path == '/') path++;
+    if (!*path) return ENTITY_NONE;
+    uint32_t i = entity_lookup_find(p, path);
+    return (i) ? entity_handle(&entity_pool.slots[i]) : ENTITY_NONE;
 }
 
-void entity_set_name(entity_t *e, const char *name) { e->name = name; }
-void entity_set_visible(entity_t *e, bool visible) { e->visible = visible; }
-void entity_set_enabled(entity_t *e, bool enabled) { e->enabled = enabled; }
-entity_t *entity_get_parent(entity_t *e) { return e->parent; }
-const char *entity_get_name(entity_t *e) { return e->name; }
-entity_t *entity_get_children(entity_t *e) { return e->children; }
-entity_t *entity_get_successor(entity_t *e) { return e->succ; }
+void entity_set_visible(entity_id_t e, bool visible) { entity_t *p = entity_get(e); if (p && ENTITY_COLD(p)->visible != visible) { ENTITY_COLD(p)->visible = visible; entity_refresh_sets(p); } }
+void entity_set_enabled(entity_id_t e, bool enabled) { entity_t *p = entity_get(e); if (p && ENTITY_COLD(p)->enabled != enabled) { ENTITY_COLD(p)->enabled = enabled; entity_refresh_sets(p); } }
+entity_id_t entity_get_parent(entity_id_t e) { entity_t *p = entity_get(e); return (p && p->parent) ? entity_handle(&entity_pool.slots[p->parent]) : ENTITY_NONE; }
+const char *entity_get_name(entity_id_t e) { entity_t *p = entity_get(e); return (p) ? ENTITY_COLD(p)->name : NULL; }
+entity_id_t entity_get_children(entity_id_t e) { entity_t *p = entity_get(e); return (p && p->children) ? entity_handle(&entity_pool.slots[p->children]) : ENTITY_NONE; }
+entity_id_t entity_get_successor(entity_id_t e) { entity_t *p = entity_get(e); return (p && p->succ) ? entity_handle(&entity_pool.slots[p->succ]) : ENTITY_NONE; }
 
 // entity transformation functions
-void entity_set_position(entity_t *e, Vector3 pos, tform_space_t global) {
+void entity_set_position(entity_id_t id, Vector3 pos, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e || entity_frozen(e) || entity_resting(e)) return;
     if (global) {
-        entity_set_position(e, (e->parent) ? Vector3Transform(pos, MatrixInvert(entity_get_tform(e->parent, TFORM_WORLD))) : pos, TFORM_LOCAL);
+        entity_set_position(id, (e->parent) ? Vector3Transform(pos, tform_world_inverse(entity_pool.slots[e->parent].tf)) : pos, TFORM_LOCAL);
     } else {
-        e->local.pos = pos; 
-        entity_invalidate_tform(e, TFORM_LOCAL);
+        entity_tforms.pos[e->tf] = pos;
+        entity_invalidate_tform(e);
     }
 }
 
-void entity_set_scale(entity_t *e, Vector3 scale, tform_space_t global) {
+void entity_set_scale(entity_id_t id, Vector3 scale, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e || entity_frozen(e) || entity_resting(e)) return;
     if (global) {
-        entity_set_scale(e, (e->parent) ? Vector3Divide(scale, entity_get_scale(e->parent, TFORM_WORLD)) : scale, TFORM_LOCAL);
+        entity_set_scale(id, (e->parent) ? Vector3Divide(scale, entity_get_scale(entity_get_parent(id), TFORM_WORLD)) : scale, TFORM_LOCAL);
     } else {
-        e->local.scale = scale; 
-        entity_invalidate_tform(e, TFORM_LOCAL);
+        entity_tforms.scale[e->tf] = scale;
+        entity_invalidate_tform(e);
     }
 }
 
-void entity_set_rotation(entity_t *e, Quaternion rot, tform_space_t global) {
+void entity_set_rotation(entity_id_t id, Quaternion rot, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e || entity_frozen(e) || entity_resting(e)) return;
     if (global) {
-        entity_set_rotation(e, (e->parent) ? QuaternionMultiply(QuaternionInvert(entity_get_rotation(e->parent, TFORM_WORLD)), rot) : rot, TFORM_LOCAL);
+        entity_set_rotation(id, (e->parent) ? QuaternionMultiply(QuaternionInvert(entity_get_rotation(entity_get_parent(id), TFORM_WORLD)), rot) : rot, TFORM_LOCAL);
     } else {
-        e->local.rot = QuaternionNormalize(rot); 
-        entity_invalidate_tform(e, TFORM_LOCAL);
+        entity_tforms.rot[e->tf] = QuaternionNormalize(rot);
+        entity_invalidate_tform(e);
     }
 }
 
-Vector3 entity_get_position(entity_t *e, tform_space_t global) {
+Vector3 entity_get_position(entity_id_t id, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e) return Vector3Zero();
     if (global) {
-        Matrix mat = entity_get_tform(e, TFORM_WORLD);
+        Matrix mat = entity_get_tform(id, TFORM_WORLD);
         return (Vector3){mat.m12, mat.m13, mat.m14};
     } else {
-        return e->local.pos; 
+        return entity_tforms.pos[e->tf];
+    }
+}
+
+Vector3 entity_get_scale(entity_id_t id, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e) return Vector3One();
+    if (global) {
+        tform_world(e->tf);
+        return entity_tforms.world_scale[e->tf];
+    } else {
+        return entity_tforms.scale[e->tf];
     }
 }
 
-Vector3 entity_get_scale(entity_t *e, tform_space_t global) {
+Quaternion entity_get_rotation(entity_id_t id, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e) return QuaternionIdentity();
     if (global) {
-        return (e->parent) ? Vector3Multiply(entity_get_scale(e->parent, TFORM_WORLD), e->local.scale) : e->local.scale;
+        tform_world(e->tf);
+        return entity_tforms.world_rot[e->tf];
     } else {
-        return e->local.scale;
+        return entity_tforms.rot[e->tf];
     }
 }
 
-Quaternion entity_get_rotation(entity_t *e, tform_space_t global) {
+void entity_set_tform(entity_id_t id, Matrix mat, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e || entity_frozen(e) || entity_resting(e)) return;
     if (global) {
-        return (e->parent) ? QuaternionMultiply(entity_get_rotation(e->parent, TFORM_WORLD), e->local.rot) : e->local.rot;
+        entity_set_tform(id, (e->parent) ? MatrixMultiply(mat, tform_world_inverse(entity_pool.slots[e->parent].tf)) : mat, TFORM_LOCAL);
+    } else {
+        entity_tforms.pos[e->tf] = (Vector3){mat.m12, mat.m13, mat.m14};
+        entity_tforms.rot[e->tf] = QuaternionFromMatrix(mat);
+        entity_tforms.scale[e->tf] = (Vector3){
+            Vector3Length((Vector3){mat.m0, mat.m1, mat.m2}),
+            Vector3Length((Vector3){mat.m4, mat.m5, mat.m6}),
+            Vector3Length((Vector3){mat.m8, mat.m9, mat.m10})
+        };
+        entity_invalidate_tform(e);
+    }
+}
+
+Matrix entity_get_tform(entity_id_t id, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    if (!e) return MatrixIdentity();
+    return (global) ? tform_world(e->tf) : tform_local(e->tf);
+}
+
+// local bounding sphere, a radius of 0 makes the entity unbounded (never culled)
+void entity_set_bounds(entity_id_t id, Vector3 center, float radius) {
+    entity_t *e = entity_get(id);
+    if (!e || entity_frozen(e)) return;
+    entity_tforms.bounds[e->tf] = (Vector4){center.x, center.y, center.z, (radius > 0.f) ? radius : 0.f};
+    entity_invalidate_tform(e); // subtree boxes and spatial index follow with the next pass
+}
+
+// static entities keep the world matrix they have when set (their parent may move, they stay put): the
+// passes skip them, entity_get_tform returns it without any dirty check, their spatial index leaf is
+// tight, and writes to their transform, bounds or parent are refused with a warning until unset
+void entity_set_static(entity_id_t id, bool enable) {
+    entity_t *e = entity_get(id);
+    if (!e) return;
+    if (enable == ((entity_tforms.dirty[e->tf] & TFORM_STATIC) != 0)) return;
+    if (enable) {
+        // lazy reads stop at static entities: resolve the pending ranges, children included, while they can
+        if (entity_dirty.resolved != entity_dirty.count) {
+            if (!entity_tforms.sorted) tform_sort();
+            tform_resolve_pending();
+        }
+        uint8_t *dirty = &entity_tforms.dirty[e->tf];
+        *dirty = (*dirty & (TFORM_DIRTY_QUEUED|TFORM_TREE_UNBOUNDED|TFORM_INVERSE_CACHED)) | TFORM_STATIC; // a queued range still updates its children
+        if (entity_bvh.enabled) {
+            bvh_drop(e);
+            bvh_update(e);
+        }
+    } else {
+        entity_tforms.dirty[e->tf] &=~TFORM_STATIC;
+        entity_invalidate_tform(e);
+    }
+}
+
+bool entity_is_static(entity_id_t id) {
+    entity_t *e = entity_get(id);
+    return e && (entity_tforms.dirty[e->tf] & TFORM_STATIC);
+}
+
+// world box of the bounded entities of the subtree as of the last entity_update_world_all, empty (min > max) if none
+BoundingBox entity_get_subtree_bounds(entity_id_t id) {
+    entity_t *e = entity_get(id);
+    if (!e) return (BoundingBox){{INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}};
+    return entity_tforms.tree_box[e->tf];
+}
+
+void entity_get_bounds(entity_id_t id, Vector3 *center, float *radius, tform_space_t global) {
+    entity_t *e = entity_get(id);
+    Vector4 b = (!e) ? (Vector4){0} : (global) ? tform_world_bounds(e->tf) : entity_tforms.bounds[e->tf];
+    if (center) *center = (Vector3){b.x, b.y, b.z};
+    if (radius) *radius = b.w;
+}
+
+static int tform_range_compare(const void *a, const void *b) {
+    uint32_t ba = ((const tform_task_t*)a)->begin, bb = ((const tform_task_t*)b)->begin;
+    return (ba > bb) - (ba < bb);
+}
+
+// resolve every dirty subtree once: each dirty root is a contiguous store range, ranges nested in
+// another dirty range are dropped, the rest is resolved linearly or across the worker threads
+// (same kernels per transform, so bit-identical results)
+void entity_update_world_all() {
+    tform_dirty_set_t *d = &entity_dirty;
+    entity_stats.dirty_roots = 0;
+    entity_stats.tforms_touched = 0;
+    entity_stats.spatial_moved = 0;
+    entity_stats.spatial_rebuilt = 0;
+    entity_stats.spatial_time = 0.f;
+    if (!d->count && !d->reshaped_count) return;
+    if (!entity_tforms.sorted) tform_sort();
+
+    // world reads since the last pass may have resolved every range already, only bounds are left then
+    bool resolved = d->resolved == d->count;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < d->count; i++) {
+        entity_t *e = (entity_is_valid(d->roots[i])) ? &entity_pool.slots[d->roots[i] & ENTITY_INDEX_MASK] : NULL;
+        if (e) d->ranges[n++] = (tform_task_t){e->tf, e->tf + entity_tforms.size[e->tf]};
+    }
+    d->count = 0;
+    d->resolved = 0;
+    qsort(d->ranges, n, sizeof(tform_task_t), tform_range_compare);
+
+    uint32_t kept = 0, end = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (d->ranges[i].begin < end) continue;
+        d->ranges[kept++] = d->ranges[i];
+        end = d->ranges[i].end;
+        entity_stats.tforms_touched += end - d->ranges[i].begin;
+    }
+    entity_stats.dirty_roots = kept;
+
+    bool parallel = false;
+#if defined(ENTITY_THREADS)
+    parallel = !resolved && entity_jobs.count > 1 && entity_stats.tforms_touched > 2*TFORM_TASK_GRAIN;
+    if (parallel) tform_jobs_run(d->ranges, kept);
+#endif
+    if (!parallel && !resolved) for (uint32_t i = 0; i < kept; i++) tform_update_range(d->ranges[i].begin, d->ranges[i].end);
+    tform_update_bounds(d->ranges, kept);
+    if (entity_bvh.enabled) bvh_refit(d->ranges, kept);
+}
+
+entity_stats_t entity_get_stats() {
+    return entity_stats;
+}
+
+// write the visible entities of the subtree of e (whole scene for ENTITY_NONE) to out,
+// returns how many there are (only max are written), hidden entities hide their subtree
+int entity_enum_visible(entity_id_t e, entity_id_t *out, int max) {
+    return entity_set_enum(&entity_visible, e, out, max);
+}
+
+int entity_enum_enabled(entity_id_t e, entity_id_t *out, int max) {
+    return entity_set_enum(&entity_enabled, e, out, max);
+}
+
+// visible entities whose world bounding sphere intersects the frustum of viewproj (view*projection),
+// returns the number of survivors and writes at most max of them
+int entity_cull(Matrix viewproj, entity_id_t *out, int max) {
+    tform_cull_t *c = &entity_culling;
+    uint32_t n = entity_visible.count;
+    if (n > c->capacity) {
+        uint32_t capacity = (c->capacity) ? c->capacity : TFORM_STORE_MIN;
+        while (capacity < n) capacity *= 2;
+        c->x = (float*)MemRealloc(c->x, capacity*sizeof(float));
+        c->y = (float*)MemRealloc(c->y, capacity*sizeof(float));
+        c->z = (float*)MemRealloc(c->z, capacity*sizeof(float));
+        c->r = (float*)MemRealloc(c->r, capacity*sizeof(float));
+        c->slot = (uint32_t*)MemRealloc(c->slot, capacity*sizeof(uint32_t));
+        c->in = (uint8_t*)MemRealloc(c->in, capacity*sizeof(uint8_t));
+        if (!c->x || !c->y || !c->z || !c->r || !c->slot || !c->in) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory to cull entities!"));
+            exit(1);
+        }
+        c->capacity = capacity;
+    }
+
+    Vector4 planes[6];
+    tform_frustum(viewproj, planes);
+    if (entity_dirty.count || entity_dirty.reshaped_count) entity_update_world_all(); // subtree boxes must be current
+    tform_store_t *s = &entity_tforms;
+    if (!s->sorted) tform_sort();
+
+    // gather the visible entities in store order, a branch whose subtree box is out is skipped in one test
+    // unless it holds unbounded entities, the survivors are then tested sphere by sphere
+    uint32_t m = 0, branches = 0;
+    for (uint32_t t = 1; t < s->count;) {
+        uint32_t i = s->owner[t];
+        bool descend = i < entity_visible.slots && entity_visible.at[i];
+        if (descend) {
+            BoundingBox box = s->tree_box[t];
+            Vector4 b = tform_world_bounds(t);
+            descend = box.min.x > box.max.x || (s->dirty[t] & TFORM_TREE_UNBOUNDED) || tform_box_visible(box, planes);
+            if (!descend) branches++;
+            else {
+                c->x[m] = b.x;
+                c->y[m] = b.y;
+                c->z[m] = b.z;
+                c->r[m] = (b.w > 0.f) ? b.w : INFINITY;
+                c->slot[m++] = i;
+            }
+        }
+        t += (descend) ? 1 : s->size[t];
+    }
+    tform_cull_batch(c, planes, m);
+
+    int kept = 0;
+    for (uint32_t k = 0; k < m; k++) {
+        if (!c->in[k]) continue;
+        if (kept < max) out[kept] = entity_handle(&entity_pool.slots[c->slot[k]]);
+        kept++;
+    }
+    entity_stats.cull_visible = kept;
+    entity_stats.cull_culled = n - kept;
+    entity_stats.cull_branches = branches;
+    return kept;
+}
+
+// maintain a spatial index over the world bounding spheres, refitted by entity_update_world_all,
+// so queries see the entities as they were at the end of the last pass (unbounded ones as points)
+void entity_set_spatial(bool enable) {
+    bvh_tree_t *b = &entity_bvh;
+    if (enable == b->enabled) return;
+    if (enable) {
+        b->enabled = true;
+        for (uint32_t i = 1; i < entity_pool.count; i++)
+            if (entity_pool.slots[i].tf) bvh_fit_leaf(&entity_pool.slots[i]);
+        bvh_rebuild();
     } else {
-        return e->local.rot;
+        for (uint32_t i = 1; i < entity_pool.count; i++) entity_pool.cold[i].leaf = 0;
+        MemFree(b->nodes);
+        MemFree(b->stack);
+        MemFree(b->moved);
+        MemFree(b->inner);
+        MemFree(b->items);
+        *b = (bvh_tree_t){0};
+    }
+}
+
+static bool bvh_test_radius(const bvh_node_t *n, const void *arg) {
+    Vector4 q = *(const Vector4*)arg;
+    if (n->owner) {
+        float dx = n->sphere.x - q.x, dy = n->sphere.y - q.y, dz = n->sphere.z - q.z, r = n->sphere.w + q.w;
+        return dx*dx + dy*dy + dz*dz <= r*r;
+    }
+    float dx = fmaxf(fmaxf(n->box.min.x - q.x, q.x - n->box.max.x), 0.f);
+    float dy = fmaxf(fmaxf(n->box.min.y - q.y, q.y - n->box.max.y), 0.f);
+    float dz = fmaxf(fmaxf(n->box.min.z - q.z, q.z - n->box.max.z), 0.f);
+    return dx*dx + dy*dy + dz*dz <= q.w*q.w;
+}
+
+static bool bvh_test_box(const bvh_node_t *n, const void *arg) {
+    const BoundingBox *q = (const BoundingBox*)arg;
+    if (n->owner) {
+        Vector4 c = n->sphere;
+        float dx = fmaxf(fmaxf(q->min.x - c.x, c.x - q->max.x), 0.f);
+        float dy = fmaxf(fmaxf(q->min.y - c.y, c.y - q->max.y), 0.f);
+        float dz = fmaxf(fmaxf(q->min.z - c.z, c.z - q->max.z), 0.f);
+        return dx*dx + dy*dy + dz*dz <= c.w*c.w;
+    }
+    return n->box.min.x <= q->max.x && n->box.max.x >= q->min.x &&
+           n->box.min.y <= q->max.y && n->box.max.y >= q->min.y &&
+           n->box.min.z <= q->max.z && n->box.max.z >= q->min.z;
+}
+
+static bool bvh_test_frustum(const bvh_node_t *n, const void *arg) {
+    const Vector4 *planes = (const Vector4*)arg;
+    if (!n->owner) return tform_box_visible(n->box, planes);
+    for (int p = 0; p < 6; p++)
+        if (planes[p].x*n->sphere.x + planes[p].y*n->sphere.y + planes[p].z*n->sphere.z + planes[p].w < -n->sphere.w) return false;
+    return true;
+}
+
+// entities whose world bounding sphere overlaps the query, returns their number and writes at most max
+int entity_query_radius(Vector3 center, float radius, entity_id_t *out, int max) {
+    Vector4 q = {center.x, center.y, center.z, radius};
+    return bvh_query(bvh_test_radius, &q, out, max);
+}
+
+int entity_query_box(BoundingBox box, entity_id_t *out, int max) {
+    return bvh_query(bvh_test_box, &box, out, max);
+}
+
+int entity_query_frustum(Matrix viewproj, entity_id_t *out, int max) {
+    Vector4 planes[6];
+    tform_frustum(viewproj, planes);
+    return bvh_query(bvh_test_frustum, planes, out, max);
+}
+
+// nearest entity whose world bounding sphere is hit by the ray, ENTITY_NONE if none
+entity_id_t entity_pick(Ray ray, float *distance) {
+    bvh_tree_t *b = &entity_bvh;
+    Vector3 o = ray.position, d = Vector3Normalize(ray.direction);
+    Vector3 inv = {1.f/d.x, 1.f/d.y, 1.f/d.z};
+    float best = INFINITY;
+    uint32_t hit = 0, top = 0, *stack = bvh_stack();
+    if (b->root) stack[top++] = b->root;
+    while (top) {
+        const bvh_node_t *n = &b->nodes[stack[--top]];
+        if (n->owner) {
+            Vector3 oc = Vector3Subtract((Vector3){n->sphere.x, n->sphere.y, n->sphere.z}, o);
+            float tca = Vector3DotProduct(oc, d), d2 = Vector3DotProduct(oc, oc) - tca*tca, r2 = n->sphere.w*n->sphere.w;
+            if (d2 > r2) continue;
+            float thc = sqrtf(r2 - d2), t = (tca - thc >= 0.f) ? tca - thc : tca + thc;
+            if (t >= 0.f && t < best) { best = t; hit = n->owner; }
+            continue;
+        }
+        float tx0 = (n->box.min.x - o.x)*inv.x, tx1 = (n->box.max.x - o.x)*inv.x;
+        float ty0 = (n->box.min.y - o.y)*inv.y, ty1 = (n->box.max.y - o.y)*inv.y;
+        float tz0 = (n->box.min.z - o.z)*inv.z, tz1 = (n->box.max.z - o.z)*inv.z;
+        float tmin = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), fmaxf(fminf(tz0, tz1), 0.f));
+        float tmax = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), fmaxf(tz0, tz1));
+        if (tmin > tmax || tmin >= best) continue;
+        stack[top++] = n->left;
+        stack[top++] = n->right;
+    }
+    if (distance) *distance = (hit) ? best : 0.f;
+    return (hit) ? entity_handle(&entity_pool.slots[hit]) : ENTITY_NONE;
+}
+
+// start count-1 worker threads next to the calling one, 0 or 1 propagates on the calling thread only
+void entity_set_threads(int count) {
+#if defined(ENTITY_THREADS)
+    tform_jobs_t *j = &entity_jobs;
+    if (count > ENTITY_MAX_THREADS) count = ENTITY_MAX_THREADS;
+    if (count < 1) count = 1;
+    if (count == j->count) return;
+
+    if (j->count > 1) {
+        pthread_mutex_lock(&j->lock);
+        j->quit = true;
+        pthread_cond_broadcast(&j->wake);
+        pthread_mutex_unlock(&j->lock);
+        for (int i = 1; i < j->count; i++) pthread_join(j->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < j->count; i++) {
+        pthread_mutex_destroy(&j->workers[i].lock);
+        MemFree(j->workers[i].tasks);
     }
+    if (j->count) {
+        pthread_mutex_destroy(&j->lock);
+        pthread_cond_destroy(&j->wake);
+    }
+
+    j->count = count;
+    j->quit = false;
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->wake, NULL);
+    for (int i = 0; i < count; i++) {
+        tform_worker_t *w = &j->workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->tasks = NULL;
+        w->top = w->bottom = w->capacity = 0;
+        w->seed = 2654435761u*(i + 1);
+        if (i && pthread_create(&w->thread, NULL, tform_jobs_main, w) != 0) {
+            TraceLog(LOG_WARNING, TextFormat("unable to start entity worker thread %i!", i));
+            pthread_mutex_destroy(&w->lock);
+            j->count = i;
+            break;
+        }
+    }
+#else
+    (void)count;
+#endif
 }
 
-void move_entity(entity_t *e, float x, float y, float z) {
+void move_entity(entity_id_t e, float x, float y, float z) {
     Vector3 pos = (Vector3){x, y, z};
     entity_set_position(e, Vector3Add(entity_get_position(e, TFORM_LOCAL), Vector3RotateByQuaternion(pos, entity_get_rotation(e, TFORM_LOCAL))), TFORM_LOCAL);
 }
 
-void turn_entity(entity_t *e, float p, float y, float r, tform_space_t global) {
-    Quaternion rot = QuaternionFromEuler(p * DEG2RAD, y * DEG2RAD, r * DEG2RAD);
-    global ?
-    entity_set_rotation(e, QuaternionMultiply(rot, entity_get_rotation(e, TFORM_WORLD)), TFORM_WORLD):
-    entity_set_rotation(e, QuaternionMultiply(entity_get_rotation(e, TFORM_LOCAL), rot), TFORM_LOCAL);
+void turn_entity(entity_id_t e, float p, float y, float r, tform_space_t global) {
+    entity_turn(e, QuaternionFromEuler(p * DEG2RAD, y * DEG2RAD, r * DEG2RAD), global);
 }
 
-void translate_entity(entity_t *e, float x, float y, float z, tform_space_t global) {
+void translate_entity(entity_id_t e, float x, float y, float z, tform_space_t global) {
     Vector3 pos = (Vector3){x, y, z};
     entity_set_position(e, Vector3Add(entity_get_position(e, global), pos), global);
 }
 
-void position_entity(entity_t *e, float x, float y, float z, tform_space_t global) {
+void position_entity(entity_id_t e, float x, float y, float z, tform_space_t global) {
     Vector3 pos = (Vector3){x, y, z};
     entity_set_position(e, pos, global);
 }
 
-void scale_entity(entity_t *e, float x, float y, float z, tform_space_t global) {
+void scale_entity(entity_id_t e, float x, float y, float z, tform_space_t global) {
     Vector3 scale = (Vector3){x, y, z};
     entity_set_scale(e, scale, global);
 }
 
-void rotate_entity(entity_t *e, float p, float y, float r, tform_space_t global) {
+void rotate_entity(entity_id_t e, float p, float y, float r, tform_space_t global) {
     Quaternion rot = QuaternionFromEuler(p * DEG2RAD, y * DEG2RAD, r * DEG2RAD);
     entity_set_rotation(e, rot, global);
 }
 
-void point_entity(entity_t *e, entity_t *t, float roll) {
-    Vector3 v = Vector3Subtract(entity_get_position(t, TFORM_WORLD), entity_get_position(e, TFORM_WORLD));
-    entity_set_rotation(e, QuaternionFromEuler(-atan2f(v.y, sqrtf(v.x*v.x+v.y*v.y)), -atan2f(v.x, v.z), roll * DEG2RAD), TFORM_WORLD);
+void point_entity(entity_id_t e, entity_id_t t, float roll) {
+    point_entities(&e, &t, 1, roll, 1.f);
 }
 
-//--------------------------------------
-// private entity functions definition
-//--------------------------------------
+void align_entity(entity_id_t e, float nx, float ny, float nz, int axis, float rate) {
+    Vector3 dir = (Vector3){nx, ny, nz};
+    align_entities(&e, &dir, 1, axis, rate);
+}
 
-void entity_insert(entity_t *e) {
-    if (e) {
-        e->succ = NULL;
-        if (e->parent) {
-            if ((e->pred = e->parent->last_child)) e->pred->succ = e;
-            else e->parent->children = e;
-            e->parent->last_child = e;
-        } else {
-            if ((e->pred = entity_last_orphan)) e->pred->succ = e;
-            else entity_orphans = e;
-            entity_last_orphan = e;
-        }
+// turn the local +z axis of each entity e[k] toward the world position of t[k], keeping the local x axis
+// level before the roll (degrees); rate in (0, 1] moves only that part of the way (nlerp) for smooth
+// tracking. Directions are read before any entity turns, list parents before their children
+void point_entities(const entity_id_t *e, const entity_id_t *t, int count, float roll, float rate) {
+    tform_aim_t *a = &entity_aiming;
+    if (count < 1 || rate <= 0.f) return;
+    tform_aim_reserve(a, count);
+    uint32_t n = 0;
+    for (int k = 0; k < count; k++) {
+        if (!entity_is_valid(e[k]) || !entity_is_valid(t[k]) || !entity_tick_due(e[k])) continue;
+        Vector3 from = entity_get_position(e[k], TFORM_WORLD), to = entity_get_position(t[k], TFORM_WORLD);
+        Quaternion rot = entity_get_rotation(e[k], TFORM_WORLD);
+        a->dx[n] = to.x - from.x; a->dy[n] = to.y - from.y; a->dz[n] = to.z - from.z;
+        a->qx[n] = rot.x; a->qy[n] = rot.y; a->qz[n] = rot.z; a->qw[n] = rot.w;
+        a->id[n++] = e[k];
     }
+    tform_point_batch(a, n, QuaternionFromEuler(0.f, 0.f, roll * DEG2RAD), rate);
+    tform_aim_write(a, n);
 }
 
-void entity_remove(entity_t *e) {
-    if (e) {
-        if (e->parent) {
-            if(e->parent->children == e) e->parent->children = e->succ;
-            if(e->parent->last_child == e) e->parent->last_child = e->pred;
-        } else {
-            if(entity_orphans == e) entity_orphans = e->succ;
-            if(entity_last_orphan == e) entity_last_orphan = e->pred;
-        }
-        if(e->succ) e->succ->pred = e->pred;
-        if(e->pred) e->pred->succ = e->succ;
+// turn each entity along the shortest arc so that its local axis (1: x, 2: y, 3: z) points along the
+// world direction dir[k], rate as for point_entities
+void align_entities(const entity_id_t *e, const Vector3 *dir, int count, int axis, float rate) {
+    tform_aim_t *a = &entity_aiming;
+    if (count < 1 || rate <= 0.f) return;
+    tform_aim_reserve(a, count);
+    uint32_t n = 0;
+    for (int k = 0; k < count; k++) {
+        if (!entity_is_valid(e[k]) || !entity_tick_due(e[k])) continue;
+        Quaternion rot = entity_get_rotation(e[k], TFORM_WORLD);
+        a->dx[n] = dir[k].x; a->dy[n] = dir[k].y; a->dz[n] = dir[k].z;
+        a->qx[n] = rot.x; a->qy[n] = rot.y; a->qz[n] = rot.z; a->qw[n] = rot.w;
+        a->id[n++] = e[k];
     }
+    tform_align_batch(a, n, axis, rate);
+    tform_aim_write(a, n);
 }
 
-void entity_invalidate_tform(entity_t *e, tform_space_t global) {
-    if (global) {
-        if (e->dirty & TFORM_DIRTY_WORLD) return;
-        e->dirty |= TFORM_DIRTY_WORLD;
-        for(entity_t *c = e->children; c; c = c->succ)
-            entity_invalidate_tform(c, TFORM_WORLD);
-    } else {
-        e->dirty |= TFORM_DIRTY_LOCAL;
-        entity_invalidate_tform(e, TFORM_WORLD);
+// deferred commands
+entity_cmds_t *entity_cmds_create() {
+    entity_cmds_t *c = (entity_cmds_t*)MemAlloc(sizeof(entity_cmds_t));
+    if (!c) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity commands!"));
+        exit(1);
     }
+    *c = (entity_cmds_t){0};
+    return c;
 }
 
-void entity_set_tform(entity_t *e, Matrix mat, tform_space_t global) {
-    if (global) {
-        entity_set_tform(e, (e->parent) ? MatrixMultiply(mat, MatrixInvert(entity_get_tform(e->parent, TFORM_WORLD))) : mat, TFORM_LOCAL);
-    } else {
-        e->local.pos = (Vector3){mat.m12, mat.m13, mat.m14};
-        e->local.rot = QuaternionFromMatrix(mat);
-        e->local.scale = (Vector3){
-            Vector3Length((Vector3){mat.m0, mat.m1, mat.m2}),
-            Vector3Length((Vector3){mat.m4, mat.m5, mat.m6}),
-            Vector3Length((Vector3){mat.m8, mat.m9, mat.m10})
-        };
-        entity_invalidate_tform(e, TFORM_LOCAL);
+void entity_cmds_destroy(entity_cmds_t *c) {
+    if (!c) return;
+    MemFree(c->items);
+    MemFree(c->resolved);
+    MemFree(c);
+}
+
+// pending handle: generation 0 (never used by a live slot) | index of the creation in the buffer + 1
+entity_id_t entity_cmd_create(entity_cmds_t *c) {
+    if (c->created == ENTITY_INDEX_MASK) {
+        TraceLog(LOG_WARNING, TextFormat("too many pending entities in command buffer!"));
+        return ENTITY_NONE;
     }
+    entity_id_t e = ++c->created;
+    entity_cmd_push(c, ENTITY_CMD_CREATE, e);
+    return e;
 }
 
-Matrix entity_get_tform(entity_t *e, tform_space_t global) {
-    if (global) {
-        if (e->dirty & TFORM_DIRTY_WORLD) {
-            e->world.mat = (e->parent) ? MatrixMultiply(entity_get_tform(e, TFORM_LOCAL), entity_get_tform(e->parent, TFORM_WORLD)) : entity_get_tform(e, TFORM_LOCAL);
-            e->dirty &=~TFORM_DIRTY_WORLD;
+void entity_cmd_free(entity_cmds_t *c, entity_id_t e) {
+    entity_cmd_push(c, ENTITY_CMD_FREE, e);
+}
+
+void entity_cmd_set_parent(entity_cmds_t *c, entity_id_t e, entity_id_t p) {
+    entity_cmd_push(c, ENTITY_CMD_SET_PARENT, e)->p = p;
+}
+
+void entity_cmd_position(entity_cmds_t *c, entity_id_t e, float x, float y, float z, tform_space_t global) {
+    entity_cmd_t *cmd = entity_cmd_push(c, ENTITY_CMD_POSITION, e);
+    cmd->v = (Vector4){x, y, z, 0.f};
+    cmd->global = global;
+}
+
+void entity_cmd_rotate(entity_cmds_t *c, entity_id_t e, float p, float y, float r, tform_space_t global) {
+    entity_cmd_t *cmd = entity_cmd_push(c, ENTITY_CMD_ROTATE, e);
+    cmd->v = QuaternionFromEuler(p * DEG2RAD, y * DEG2RAD, r * DEG2RAD);
+    cmd->global = global;
+}
+
+void entity_cmd_turn(entity_cmds_t *c, entity_id_t e, float p, float y, float r, tform_space_t global) {
+    entity_cmd_t *cmd = entity_cmd_push(c, ENTITY_CMD_TURN, e);
+    cmd->v = QuaternionFromEuler(p * DEG2RAD, y * DEG2RAD, r * DEG2RAD);
+    cmd->global = global;
+}
+
+void entity_cmd_scale(entity_cmds_t *c, entity_id_t e, float x, float y, float z, tform_space_t global) {
+    entity_cmd_t *cmd = entity_cmd_push(c, ENTITY_CMD_SCALE, e);
+    cmd->v = (Vector4){x, y, z, 0.f};
+    cmd->global = global;
+}
+
+void entity_cmd_move(entity_cmds_t *c, entity_id_t e, float x, float y, float z) {
+    entity_cmd_push(c, ENTITY_CMD_MOVE, e)->v = (Vector4){x, y, z, 0.f};
+}
+
+// replay the buffers in the given order, each one in recording order, so the result does not depend on
+// thread timing; runs of the same operation go through a bulk path, buffers are left empty
+void entity_cmds_apply(entity_cmds_t **bufs, int count) {
+    for (int b = 0; b < count; b++) {
+        entity_cmds_t *c = bufs[b];
+        if (!c) continue;
+        if (c->created > c->resolved_capacity) {
+            c->resolved = (entity_id_t*)MemRealloc(c->resolved, c->created*sizeof(entity_id_t));
+            if (!c->resolved) {
+                TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity commands!"));
+                exit(1);
+            }
+            c->resolved_capacity = c->created;
         }
-        return e->world.mat;
-    } else {
-        if (e->dirty & TFORM_DIRTY_LOCAL) {
-            Matrix rot, scl, pos; 
-            Vector3 axis; float angle;
+        for (uint32_t k = 0; k < c->count;) {
+            uint32_t end = k + 1;
+            while (end < c->count && c->items[end].op == c->items[k].op) end++;
+            entity_cmds_run(c, k, end);
+            k = end;
+        }
+        c->count = 0;
+        c->created = 0;
+    }
+}
 
-            // Calculate transformation matrix from local transform
-            QuaternionToAxisAngle(e->local.rot, &axis, &angle);
-            rot = MatrixRotate(axis, angle);
-            scl = MatrixScale(e->local.scale.x, e->local.scale.y, e->local.scale.z);
-            pos = MatrixTranslate(e->local.pos.x, e->local.pos.y, e->local.pos.z);
-            
-            // Get transform matrix (rotation -> scale -> translation)
-            e->local.mat = MatrixMultiply(MatrixMultiply(scl, rot), pos);
+// handle of an entity created by the last apply of c from its pending handle, other handles unchanged
+entity_id_t entity_cmds_resolve(const entity_cmds_t *c, entity_id_t e) {
+    if (!e || (e >> ENTITY_INDEX_BITS)) return e;
+    return (e <= c->resolved_capacity) ? c->resolved[e - 1] : ENTITY_NONE;
+}
 
-            e->dirty &=~TFORM_DIRTY_LOCAL;
+// transform snapshots
+// resolve the world matrices and copy them into a snapshot no reader holds, then make it current;
+// returns false (nothing published) if readers still hold every other snapshot
+bool entity_publish() {
+    entity_snapshots_t *ss = &entity_snapshots;
+    entity_snapshot_t *current = ss->current, *snap = NULL;
+    for (int k = 0; k < ENTITY_SNAPSHOTS && !snap; k++) {
+        entity_snapshot_t *b = &ss->buffers[k];
+#if defined(ENTITY_THREADS)
+        if (b != current && atomic_load(&b->readers) == 0) snap = b;
+#else
+        if (b != current) snap = b;
+#endif
+    }
+    if (!snap) return false;
+
+    entity_update_world_all();
+    if (snap->capacity < entity_pool.capacity) {
+        snap->world = (Matrix*)MemRealloc(snap->world, entity_pool.capacity*sizeof(Matrix));
+        snap->gen = (uint32_t*)MemRealloc(snap->gen, entity_pool.capacity*sizeof(uint32_t));
+        if (!snap->world || !snap->gen) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for transform snapshot!"));
+            exit(1);
         }
-        return e->local.mat;
+        snap->capacity = entity_pool.capacity;
+    }
+    for (uint32_t i = 1; i < entity_pool.count; i++) {
+        entity_t *e = &entity_pool.slots[i];
+        snap->gen[i] = (e->tf) ? e->gen : 0;
+        if (e->tf) snap->world[i] = entity_tforms.world[e->tf];
     }
+    snap->slots = entity_pool.count;
+    snap->frame = ++ss->frame;
+#if defined(ENTITY_THREADS)
+    atomic_store(&ss->current, snap);
+#else
+    ss->current = snap;
+#endif
+    return true;
 }
 
-//--------------------------------------
-// Global Variables Definition
-//--------------------------------------
-static int screen_width = 1024;
-static int screen_height = 768;
+// latest published snapshot, NULL before the first entity_publish, callable from any thread;
+// it stays unchanged until entity_snapshot_release
+const entity_snapshot_t *entity_snapshot_acquire() {
+#if defined(ENTITY_THREADS)
+    for (;;) {
+        entity_snapshot_t *snap = atomic_load(&entity_snapshots.current);
+        if (!snap) return NULL;
+        atomic_fetch_add(&snap->readers, 1);
+        if (snap == atomic_load(&entity_snapshots.current)) return snap;
+        atomic_fetch_sub(&snap->readers, 1); // replaced meanwhile, it may be recycled already
+    }
+#else
+    return entity_snapshots.current;
+#endif
+}
 
-static Camera camera = {0};
-static entity_t *center = NULL;
-static entity_t *child1 = NULL;
-static entity_t *child2 = NULL;
-static entity_t *child3 = NULL;
+void entity_snapshot_release(const entity_snapshot_t *snap) {
+#if defined(ENTITY_THREADS)
+    if (snap) atomic_fetch_sub(&((entity_snapshot_t*)snap)->readers, 1);
+#else
+    (void)snap;
+#endif
+}
 
-static Model cube;
-static Model sphere;
+// world matrix of e when snap was published, false if e did not exist then
+bool entity_snapshot_tform(const entity_snapshot_t *snap, entity_id_t e, Matrix *mat) {
+    uint32_t i = e & ENTITY_INDEX_MASK;
+    if (!snap || !i || i >= snap->slots || snap->gen[i] != (e >> ENTITY_INDEX_BITS)) return false;
+    *mat = snap->world[i];
+    return true;
+}
 
-static float dt = 0.f;
+uint64_t entity_snapshot_frame(const entity_snapshot_t *snap) {
+    return (snap) ? snap->frame : 0;
+}
 
-//--------------------------------------
-// Module Functions Declaration
-//--------------------------------------
-void UpdateDrawFrame(void);     // Update and Draw one frame
-void DrawEntityModel(entity_t *e, Model model, Color tint);
-void DrawEntityOrbit(entity_t *e, Color tint);
-
-//----------------------------------------------------------------------------------
-// Main Enry Point
-//----------------------------------------------------------------------------------
-int main()
-{
-    //--------------------------------------
-    // Initialization
-    //--------------------------------------
-    InitWindow(screen_width, screen_height, "raylib: entity system");
-
-    // camera 3d
-    camera.position = (Vector3){0.f, 10.f, 15.f};
-    camera.target = (Vector3){0.f, 0.f, 0.f};
-    camera.up = (Vector3){0.f, 1.f, 0.f};
-    camera.fovy = 45.f;
-    camera.projection = CAMERA_PERSPECTIVE;
-
-    // entities
-    center = create_entity();
-    child1 = create_entity();
-    child2 = create_entity();
-    child3 = create_entity();
-
-    entity_set_parent(child1, center);
-    position_entity(child1, 0.f, 0.f, -5.f, TFORM_LOCAL);
-
-    entity_set_parent(child2, child1);
-    scale_entity(child2, 0.5f, 0.5f, 0.5f, TFORM_LOCAL);
-    position_entity(child2, 3.f, 0.f, 0.f, TFORM_LOCAL);
-
-    entity_set_parent(child3, child2);
-    scale_entity(child3, 0.25f, 0.25f, 0.25f, TFORM_LOCAL);
-    position_entity(child3, 0.f, 0.f, -2.f, TFORM_LOCAL);
-
-    // models
-    cube = LoadModelFromMesh(GenMeshCube(1.0f, 1.0f, 1.0f));
-    sphere = LoadModelFromMesh(GenMeshSphere(1.0f, 12, 8));
-
-#if defined(PLATFORM_WEB)
-    emscripten_set_main_loop(UpdateDrawFrame, 0, 1);
-#else
-    SetTargetFPS(60);   // Set our game to run at 60 frames-per-second
-    
-    // Main game loop
-    while (!WindowShouldClose())    // Detect window close button or ESC key
-    {
-        UpdateDrawFrame();
+// animation
+// clip of tracks*keys keyframes, all tracks unbound, keys at identity and 1 second apart
+entity_clip_t *entity_clip_create(int tracks, int keys) {
+    if (tracks < 1 || keys < 1) return NULL;
+    size_t n = (size_t)tracks*keys;
+    entity_clip_t *clip = (entity_clip_t*)MemAlloc(sizeof(entity_clip_t));
+    if (clip) {
+        clip->tracks = tracks;
+        clip->keys = keys;
+        clip->times = (float*)MemAlloc(keys*sizeof(float));
+        clip->channels = (float*)MemAlloc(CLIP_CHANNELS*n*sizeof(float));
+        clip->sample = (float*)MemAlloc(CLIP_CHANNELS*tracks*sizeof(float));
+        clip->targets = (entity_id_t*)MemAlloc(tracks*sizeof(entity_id_t));
+        clip->order = (uint64_t*)MemAlloc(tracks*sizeof(uint64_t));
     }
-#endif
-    //--------------------------------------
-    // De-Initialization
-    //--------------------------------------
-    if (center) free_entity(center);
+    if (!clip || !clip->times || !clip->channels || !clip->sample || !clip->targets || !clip->order) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for animation clip!"));
+        exit(1);
+    }
+    for (int k = 0; k < keys; k++) clip->times[k] = (float)k;
+    for (int c = 0; c < CLIP_CHANNELS; c++) {
+        float v = (c == CLIP_RW || c >= CLIP_SX) ? 1.f : 0.f;
+        for (size_t i = 0; i < n; i++) clip->channels[c*n + i] = v;
+    }
+    for (int i = 0; i < tracks; i++) {
+        clip->targets[i] = ENTITY_NONE;
+        clip->order[i] = (uint64_t)i;
+    }
+    return clip;
+}
+
+void entity_clip_destroy(entity_clip_t *clip) {
+    if (!clip) return;
+    MemFree(clip->times);
+    MemFree(clip->channels);
+    MemFree(clip->sample);
+    MemFree(clip->targets);
+    MemFree(clip->order);
+    MemFree(clip);
+}
 
-    CloseWindow();        // Close window and OpenGL context
+void entity_clip_bind(entity_clip_t *clip, int track, entity_id_t e) {
+    if (track >= 0 && track < clip->tracks) clip->targets[track] = e;
+}
 
-    return 0;
+void entity_clip_set_time(entity_clip_t *clip, int key, float time) {
+    if (key >= 0 && key < clip->keys) clip->times[key] = time;
 }
 
-//----------------------------------------------------------------------------------
-// Module Functions Definition
-//----------------------------------------------------------------------------------
-void UpdateDrawFrame(void)
-{
-    //--------------------------------------
-    // Update
-    //--------------------------------------
-    dt = GetFrameTime();
+// local transform of a track at a key, the rotation is normalized and kept in the hemisphere of the
+// previous key so samples interpolate along the short arc
+void entity_clip_set_key(entity_clip_t *clip, int track, int key, Vector3 pos, Quaternion rot, Vector3 scale) {
+    if (track < 0 || track >= clip->tracks || key < 0 || key >= clip->keys) return;
+    size_t n = (size_t)clip->tracks*clip->keys, i = (size_t)key*clip->tracks + track;
+    float *ch = clip->channels;
+    rot = QuaternionNormalize(rot);
+    if (key > 0) {
+        size_t j = i - clip->tracks;
+        float dot = ch[CLIP_RX*n + j]*rot.x + ch[CLIP_RY*n + j]*rot.y + ch[CLIP_RZ*n + j]*rot.z + ch[CLIP_RW*n + j]*rot.w;
+        if (dot < 0.f) rot = (Quaternion){-rot.x, -rot.y, -rot.z, -rot.w};
+    }
+    ch[CLIP_PX*n + i] = pos.x; ch[CLIP_PY*n + i] = pos.y; ch[CLIP_PZ*n + i] = pos.z;
+    ch[CLIP_RX*n + i] = rot.x; ch[CLIP_RY*n + i] = rot.y; ch[CLIP_RZ*n + i] = rot.z; ch[CLIP_RW*n + i] = rot.w;
+    ch[CLIP_SX*n + i] = scale.x; ch[CLIP_SY*n + i] = scale.y; ch[CLIP_SZ*n + i] = scale.z;
+}
 
-    turn_entity(center,0.f, .3f, 0.f, TFORM_LOCAL);
-    turn_entity(child1,0.f, .6f, 0.f, TFORM_LOCAL);
-    turn_entity(child2,0.f,-2.f, 0.f, TFORM_LOCAL);
+float entity_clip_duration(const entity_clip_t *clip) {
+    return clip->times[clip->keys - 1] - clip->times[0];
+}
 
-    //--------------------------------------
-    // Draw
-    //--------------------------------------
-    BeginDrawing();
+// sample every track of each clip at its time (clamped to the keys, wrap it for a loop) and write the
+// local transforms straight into the store, each animated subtree is queued once for the next pass
+void entity_animate(entity_clip_t **clips, const float *times, int count) {
+    for (int c = 0; c < count; c++) {
+        if (!clips[c]) continue;
+        clip_sample(clips[c], times[c]);
+        clip_write(clips[c]);
+    }
+}
 
-        ClearBackground(WHITE);
+// tick groups
+// members of a group are spread over its frames (phases assigned in turn), so every frame updates about
+// the same share of them
+void entity_set_tick(entity_id_t id, entity_tick_t group) {
+    entity_t *e = entity_get(id);
+    if (!e || group < 0 || group >= ENTITY_TICK_GROUPS) return;
+    entity_ticks_t *k = &entity_ticks;
+    uint32_t i = e - entity_pool.slots;
+    entity_tick_rec_t *r = entity_tick_rec(i);
+    if (group == ENTITY_TICK_ALWAYS) {
+        if (r) {
+            uint32_t at = k->at[i] - 1;
+            k->at[i] = 0;
+            k->items[at] = k->items[--k->count];
+            uint32_t *moved = &k->at[k->items[at].id & ENTITY_INDEX_MASK];
+            if (*moved == k->count + 1) *moved = at + 1;
+        }
+        return;
+    }
+    if (!r) {
+        if (i >= k->slots) {
+            uint32_t slots = entity_pool.capacity;
+            k->at = (uint32_t*)MemRealloc(k->at, slots*sizeof(uint32_t));
+            if (!k->at) {
+                TraceLog(LOG_ERROR, TextFormat("unable allocate memory for tick groups!"));
+                exit(1);
+            }
+            memset(k->at + k->slots, 0, (slots - k->slots)*sizeof(uint32_t));
+            k->slots = slots;
+        }
+        if (k->count == k->capacity) {
+            k->capacity = (k->capacity) ? k->capacity*2 : 64;
+            k->items = (entity_tick_rec_t*)MemRealloc(k->items, k->capacity*sizeof(entity_tick_rec_t));
+            if (!k->items) {
+                TraceLog(LOG_ERROR, TextFormat("unable allocate memory for tick groups!"));
+                exit(1);
+            }
+        }
+        r = &k->items[k->count++];
+        k->at[i] = k->count;
+        r->id = id;
+        r->due = true;
+        r->period = 0; // nothing recorded yet
+    }
+    r->group = (uint8_t)group;
+    r->phase = (uint8_t)(k->joined[group]++ & 3);
+}
 
-        BeginMode3D(camera);
-            DrawEntityModel(center, cube, RED);
-            DrawEntityModel(child1, cube, GREEN);
-            DrawEntityModel(child2, sphere, BLUE);
-            DrawEntityModel(child3, sphere, MAGENTA);
+entity_tick_t entity_get_tick(entity_id_t id) {
+    entity_t *e = entity_get(id);
+    entity_tick_rec_t *r = (e) ? entity_tick_rec(e - entity_pool.slots) : NULL;
+    return (r) ? (entity_tick_t)r->group : ENTITY_TICK_ALWAYS;
+}
 
-            DrawEntityOrbit(child1, GREEN);
-            DrawEntityOrbit(child2, BLUE);
-            DrawEntityOrbit(child3, MAGENTA);
+void entity_set_tick_distances(float half, float quarter) {
+    entity_ticks.half = half;
+    entity_ticks.quarter = quarter;
+}
 
-            DrawGrid(10, 1.f);
-        EndMode3D();
+// start a frame: decide which entities of the tick groups are due, ENTITY_TICK_DISTANCE ones by the
+// distance of their last resolved position to camera; returns the frame number
+uint32_t entity_tick_begin(Vector3 camera) {
+    entity_ticks_t *k = &entity_ticks;
+    k->frame++;
+    k->camera = camera;
+    for (uint32_t n = 0; n < k->count;) {
+        entity_tick_rec_t *r = &k->items[n];
+        entity_t *e = (entity_is_valid(r->id)) ? &entity_pool.slots[r->id & ENTITY_INDEX_MASK] : NULL;
+        if (!e) { // freed since, its slot may be in use again (and indexed to another record)
+            uint32_t *at = &k->at[r->id & ENTITY_INDEX_MASK];
+            if (*at == n + 1) *at = 0;
+            *r = k->items[--k->count];
+            at = &k->at[r->id & ENTITY_INDEX_MASK];
+            if (*at == k->count + 1) *at = n + 1;
+            continue;
+        }
+        uint32_t period = (r->group == ENTITY_TICK_HALF) ? 2 : (r->group == ENTITY_TICK_QUARTER) ? 4 : 1;
+        if (r->group == ENTITY_TICK_DISTANCE) {
+            Matrix m = entity_tforms.world[e->tf];
+            float d = Vector3Distance((Vector3){m.m12, m.m13, m.m14}, camera);
+            period = (k->quarter > 0.f && d >= k->quarter) ? 4 : (k->half > 0.f && d >= k->half) ? 2 : 1;
+        }
+        r->due = (k->frame & (period - 1)) == (r->phase & (period - 1));
+        n++;
+    }
+    return k->frame;
+}
 
-        // draw texts
-        DrawFPS(0, 0);
+// false if e belongs to a tick group that skips this frame
+bool entity_tick_due(entity_id_t id) {
+    entity_t *e = entity_get(id);
+    return e && !entity_resting(e);
+}
 
-    EndDrawing();
+// true if e belongs to a tick group that skips this frame, its transform writes are dropped
+bool entity_resting(const entity_t *e) {
+    entity_tick_rec_t *r = (entity_ticks.count) ? entity_tick_rec(e - entity_pool.slots) : NULL;
+    return r && !r->due;
 }
 
-// Draw a entity model
-void DrawEntityModel(entity_t *e, Model model, Color tint) {
-    model.transform = entity_get_tform(e, TFORM_WORLD);
+// end a frame: resolve the world transforms and record the ones of the entities that were due
+void entity_tick_end() {
+    entity_ticks_t *k = &entity_ticks;
+    if (!k->count) return;
+    entity_update_world_all();
+    for (uint32_t n = 0; n < k->count; n++) {
+        entity_tick_rec_t *r = &k->items[n];
+        if (r->due && entity_is_valid(r->id)) entity_tick_record(r);
+    }
+}
 
-    for (int i = 0; i < model.meshCount; i++)
-    {
-        Color color = model.materials[model.meshMaterial[i]].maps[MATERIAL_MAP_DIFFUSE].color;
+// world matrix to draw e with: for an entity of a tick group, its last record on the frame it was due, then
+// extrapolated along the motion between its last two records over the skipped frames, so that it is
+// neither late nor jerky while its motion is steady (and overshoots by up to one period when it stops);
+// its children follow its world matrix, give them the same group
+Matrix entity_get_render_tform(entity_id_t id) {
+    entity_t *e = entity_get(id);
+    if (!e) return MatrixIdentity();
+    entity_tick_rec_t *r = (entity_ticks.count) ? entity_tick_rec(e - entity_pool.slots) : NULL;
+    if (!r || !r->period) return tform_world(e->tf);
+    uint32_t late = entity_ticks.frame - r->frame;
+    if (!late) return tform_compose(r->pos[1], r->rot[1], r->scale[1]);
+    float t = 1.f + ((late < r->period) ? (float)late/r->period : 1.f);
+    Quaternion a = r->rot[0], b = r->rot[1];
+    if (a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w < 0.f) b = (Quaternion){-b.x, -b.y, -b.z, -b.w};
+    return tform_compose(Vector3Lerp(r->pos[0], r->pos[1], t), QuaternionNlerp(a, b, t), Vector3Lerp(r->scale[0], r->scale[1], t));
+}
 
-        Color colorTint = WHITE;
-        colorTint.r = (unsigned char)((((float)color.r/255.0)*((float)tint.r/255.0))*255.0f);
-        colorTint.g = (unsigned char)((((float)color.g/255.0)*((float)tint.g/255.0))*255.0f);
-        colorTint.b = (unsigned char)((((float)color.b/255.0)*((float)tint.b/255.0))*255.0f);
-        colorTint.a = (unsigned char)((((float)color.a/255.0)*((float)tint.a/255.0))*255.0f);
+// scene files
+// write the subtree of root (ENTITY_NONE for every entity) as a scene file, its root keeps its local transform
+bool entity_save_scene(const char *path, entity_id_t root) {
+#if defined(ENTITY_SCENE_BIG_ENDIAN)
+    TraceLog(LOG_WARNING, TextFormat("scene files need a little endian host!"));
+    return false;
+#endif
+    entity_t *e = (root) ? entity_get(root) : NULL;
+    tform_store_t *s = &entity_tforms;
+    if ((root && !e) || s->count < 2) return false;
+    if (!s->sorted) tform_sort();
+    uint32_t t = (e) ? e->tf : 1, n = (e) ? s->size[t] : s->count - 1;
+
+    // each distinct name once, found back through its slot in the intern table
+    uint32_t *name_at = (entity_names.capacity) ? (uint32_t*)MemAlloc(entity_names.capacity*sizeof(uint32_t)) : NULL;
+    if (entity_names.capacity && !name_at) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for scene file!"));
+        exit(1);
+    }
+    uint32_t names = 0, offset[SCENE_ARRAYS];
+    for (uint32_t k = 0; k < n; k++) {
+        const char *name = entity_pool.cold[s->owner[t + k]].name;
+        if (!name) continue;
+        uint32_t h = entity_name_slot(name);
+        if (!name_at[h]) {
+            name_at[h] = names + 1;
+            names += strlen(name) + 1;
+        }
+    }
 
-        model.materials[model.meshMaterial[i]].maps[MATERIAL_MAP_DIFFUSE].color = colorTint;
-        DrawMesh(model.meshes[i], model.materials[model.meshMaterial[i]], model.transform);
-        model.materials[model.meshMaterial[i]].maps[MATERIAL_MAP_DIFFUSE].color = color;
+    uint32_t size = entity_scene_layout(n, names, offset);
+    uint8_t *data = (size) ? (uint8_t*)MemAlloc(size) : NULL;
+    if (!data) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for scene file!"));
+        exit(1);
     }
+    *(entity_scene_header_t*)data = (entity_scene_header_t){ENTITY_SCENE_MAGIC, ENTITY_SCENE_VERSION, n, names, size, {0}};
+    memcpy(data + offset[SCENE_POS], &s->pos[t], n*sizeof(Vector3));
+    memcpy(data + offset[SCENE_ROT], &s->rot[t], n*sizeof(Quaternion));
+    memcpy(data + offset[SCENE_SCALE], &s->scale[t], n*sizeof(Vector3));
+    memcpy(data + offset[SCENE_BOUNDS], &s->bounds[t], n*sizeof(Vector4));
+    uint32_t *parent = (uint32_t*)(data + offset[SCENE_PARENT]), *name = (uint32_t*)(data + offset[SCENE_NAME]);
+    uint8_t *flags = data + offset[SCENE_FLAGS];
+    for (uint32_t k = 0; k < n; k++) {
+        entity_cold_t *c = &entity_pool.cold[s->owner[t + k]];
+        uint32_t q = s->parent[t + k];
+        parent[k] = (q >= t && q < t + n) ? q - t + 1 : 0;
+        flags[k] = (c->visible ? SCENE_VISIBLE : 0) | (c->enabled ? SCENE_ENABLED : 0) | ((s->dirty[t + k] & TFORM_STATIC) ? SCENE_STATIC : 0);
+        name[k] = 0;
+        if (!c->name) continue;
+        name[k] = name_at[entity_name_slot(c->name)];
+        strcpy((char*)data + offset[SCENE_NAMES] + name[k] - 1, c->name);
+    }
+
+    bool saved = SaveFileData(path, data, size);
+    MemFree(data);
+    MemFree(name_at);
+    return saved;
 }
 
-void DrawEntityOrbit(entity_t *e, Color tint) {
-    if (e->parent) {
-        Vector3 axis; 
-        float angle, length;
-        length = Vector3Length(Vector3Subtract(entity_get_position(e->parent, TFORM_WORLD), entity_get_position(e, TFORM_WORLD)));
-        QuaternionToAxisAngle(entity_get_rotation(e->parent, TFORM_WORLD), &axis, &angle);
-        DrawCircle3D(entity_get_position(e->parent, TFORM_WORLD), length, (Vector3){1.f, 0.f, 0.f}, 90.f, tint); //FIXME: axis, angle!
+// create the entities of a scene file image under parent (ENTITY_NONE for roots) and return the first root:
+// the arrays are copied into the store as one block, the hierarchy is linked in a single pass and only the
+// roots are flagged dirty; data must be 4 bytes aligned (the index arrays are read in place) and stays the caller's
+entity_id_t entity_adopt_scene(const void *data, uint32_t size, entity_id_t parent) {
+#if defined(ENTITY_SCENE_BIG_ENDIAN)
+    TraceLog(LOG_WARNING, TextFormat("scene files need a little endian host!"));
+    return ENTITY_NONE;
+#endif
+    const entity_scene_header_t *h = (const entity_scene_header_t*)data;
+    const uint8_t *bytes = (const uint8_t*)data;
+    uint32_t offset[SCENE_ARRAYS] = {0}, n = 0, names = 0;
+    bool valid = data && !((uintptr_t)data & 3) && size >= sizeof(entity_scene_header_t) &&
+        h->magic == ENTITY_SCENE_MAGIC && h->version == ENTITY_SCENE_VERSION;
+    if (valid) {
+        n = h->count;
+        names = h->names;
+        uint32_t total = entity_scene_layout(n, names, offset);
+        valid = n && n <= ENTITY_INDEX_MASK && total && total == h->size && total <= size &&
+            (!names || !bytes[offset[SCENE_NAMES] + names - 1]); // every name ends within the table
+    }
+    const uint32_t *par = (const uint32_t*)(bytes + offset[SCENE_PARENT]), *name = (const uint32_t*)(bytes + offset[SCENE_NAME]);
+    const uint8_t *flags = bytes + offset[SCENE_FLAGS];
+
+    // pre-order: the parent of k is k - 1 or one of its ancestors, each walked past entity is never a
+    // parent again so the check is linear
+    for (uint32_t k = 0; valid && k < n; k++) {
+        uint32_t a = k;
+        while (a && a != par[k]) a = par[a - 1];
+        valid = a == par[k] && name[k] <= names;
+    }
+    if (!valid) {
+        TraceLog(LOG_WARNING, TextFormat("invalid or unsupported scene data!"));
+        return ENTITY_NONE;
+    }
+    entity_t *pe = (parent) ? entity_get(parent) : NULL;
+    if (parent && !pe) return ENTITY_NONE;
+
+    tform_store_t *s = &entity_tforms;
+    if (!s->sorted) tform_sort();
+    uint32_t p = (pe) ? (uint32_t)(pe - entity_pool.slots) : ENTITY_NONE, pt = (pe) ? pe->tf : 0, c = tform_append_block(n);
+    memcpy(&s->pos[c], bytes + offset[SCENE_POS], n*sizeof(Vector3));
+    memcpy(&s->rot[c], bytes + offset[SCENE_ROT], n*sizeof(Quaternion));
+    memcpy(&s->scale[c], bytes + offset[SCENE_SCALE], n*sizeof(Vector3));
+    memcpy(&s->bounds[c], bytes + offset[SCENE_BOUNDS], n*sizeof(Vector4));
+    memset(&s->dirty[c], 0, n*sizeof(uint8_t));
+
+    bool baked = false;
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t j = s->owner[c + k];
+        entity_t *to = &entity_pool.slots[j];
+        entity_cold_t *ct = &entity_pool.cold[j];
+        to->parent = (par[k]) ? s->owner[c + par[k] - 1] : p;
+        to->children = ENTITY_NONE;
+        to->succ = ENTITY_NONE;
+        to->tf = c + k;
+        ct->pred = ENTITY_NONE;
+        ct->last_child = ENTITY_NONE;
+        ct->leaf = 0;
+        ct->visible = (flags[k] & SCENE_VISIBLE) != 0;
+        ct->enabled = (flags[k] & SCENE_ENABLED) != 0;
+        ct->name = (name[k]) ? entity_intern((const char*)bytes + offset[SCENE_NAMES] + name[k] - 1, strlen((const char*)bytes + offset[SCENE_NAMES] + name[k] - 1), true) : NULL;
+        s->parent[c + k] = (par[k]) ? c + par[k] - 1 : pt; // roots are spliced under parent below
+        s->size[c + k] = 1;
+        baked |= (flags[k] & SCENE_STATIC) != 0;
+
+        // children come in order, append each one after its previous sibling; roots go through entity_insert
+        if (par[k]) {
+            entity_t *q = &entity_pool.slots[to->parent];
+            if ((ct->pred = ENTITY_COLD(q)->last_child)) entity_pool.slots[ct->pred].succ = j;
+            else q->children = j;
+            ENTITY_COLD(q)->last_child = j;
+            if (ct->name) entity_lookup_add(j);
+        }
+        entity_join_sets(j);
+    }
+    for (uint32_t k = n - 1; k; k--) if (par[k]) s->size[c + par[k] - 1] += s->size[c + k];
+
+    // static entities bake the world matrix they get under parent now
+    if (baked) {
+        if (pt) tform_world(pt);
+        tform_update_range(c, c + n);
+        for (uint32_t k = 0; k < n; k++) if (flags[k] & SCENE_STATIC) s->dirty[c + k] |= TFORM_STATIC;
+    }
+
+    // splicing a root leaves the roots after it in place
+    entity_id_t first = ENTITY_NONE;
+    for (uint32_t k = 0, m; k < n; k += m) {
+        entity_t *root = &entity_pool.slots[s->owner[c + k]];
+        m = s->size[c + k];
+        entity_insert(root);
+        s->parent[c + k] = 0;
+        if (pt && (!s->sorted || !tform_splice(c + k, pt))) {
+            s->parent[root->tf] = pt;
+            s->sorted = false;
+        }
+        entity_invalidate_tform(root);
+        if (!first) first = entity_handle(root);
     }
-}
\ No newline at end of file
+    return first;
+}
+
+// map (or read where mapping is not available) a scene file and adopt it under parent
+entity_id_t entity_load_scene(const char *path, entity_id_t parent) {
+    entity_id_t root = ENTITY_NONE;
+#if defined(ENTITY_MMAP)
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && !fstat(fd, &st) && st.st_size > 0 && (uint64_t)st.st_size <= UINT32_MAX) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data != MAP_FAILED) {
+            root = entity_adopt_scene(data, (uint32_t)st.st_size, parent);
+            munmap(data, (size_t)st.st_size);
+            return root;
+        }
+    } else if (fd >= 0) close(fd);
+#endif
+    unsigned int size = 0;
+    unsigned char *data = LoadFileData(path, &size);
+    if (!data) return ENTITY_NONE;
+    root = entity_adopt_scene(data, size, parent);
+    UnloadFileData(data);
+    return root;
+}
+
+//--------------------------------------
+// private entity functions definition
+//--------------------------------------
+
+// resolve a handle to its slot, NULL (with a warning) if the handle is stale
+entity_t *entity_get(entity_id_t e) {
+    if (entity_is_valid(e)) return &entity_pool.slots[e & ENTITY_INDEX_MASK];
+    if (e != ENTITY_NONE) TraceLog(LOG_WARNING, TextFormat("stale entity handle 0x%08x!", e));
+    return NULL;
+}
+
+entity_id_t entity_handle(const entity_t *e) {
+    return (e->gen << ENTITY_INDEX_BITS) | (uint32_t)(e - entity_pool.slots);
+}
+
+// pop a recycled slot or append a new one, may move the pool
+uint32_t entity_alloc() {
+    uint32_t i = entity_pool.free_head;
+    if (i) {
+        entity_pool.free_head = entity_pool.slots[i].succ;
+        return i;
+    }
+    entity_reserve(entity_pool.count + 1);
+    i = entity_pool.count++;
+    entity_pool.slots[i].gen = 1;
+    return i;
+}
+
+// grow the pool to hold at least count slots (slot 0 included), doubling its capacity
+void entity_reserve(uint32_t count) {
+    if (count <= entity_pool.capacity) return;
+    uint32_t capacity = (entity_pool.capacity) ? entity_pool.capacity : ENTITY_POOL_MIN;
+    while (capacity < count) capacity *= 2;
+    entity_t *slots = (capacity <= ENTITY_INDEX_MASK + 1) ? (entity_t*)MemRealloc(entity_pool.slots, capacity*sizeof(entity_t)) : NULL;
+    entity_cold_t *cold = (slots) ? (entity_cold_t*)MemRealloc(entity_pool.cold, capacity*sizeof(entity_cold_t)) : NULL;
+    if (!slots || !cold) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory to create new entity!"));
+        exit(1);
+    }
+    entity_pool.slots = slots;
+    entity_pool.cold = cold;
+    entity_pool.capacity = capacity;
+    if (!entity_pool.count) entity_pool.count = 1; // slot 0 is the null entity
+}
+
+// push a slot on the free list, bumping its generation invalidates every outstanding handle
+void entity_release(entity_t *e) {
+    entity_cold_t *c = ENTITY_COLD(e);
+    if (c->name) {
+        entity_lookup_del(e - entity_pool.slots); // no-op for the subtree root, removed already
+        c->name = NULL;
+    }
+    e->gen = (e->gen + 1) & ENTITY_GEN_MASK;
+    if (!e->gen) e->gen = 1;
+    e->tf = 0;
+    e->succ = entity_pool.free_head;
+    entity_pool.free_head = e - entity_pool.slots;
+}
+
+void entity_insert(entity_t *e) {
+    if (e) {
+        uint32_t i = e - entity_pool.slots;
+        entity_cold_t *c = &entity_pool.cold[i];
+        e->succ = ENTITY_NONE;
+        if (e->parent) {
+            entity_t *p = &entity_pool.slots[e->parent];
+            if ((c->pred = ENTITY_COLD(p)->last_child)) entity_pool.slots[c->pred].succ = i;
+            else p->children = i;
+            ENTITY_COLD(p)->last_child = i;
+        } else {
+            if ((c->pred = entity_last_orphan)) entity_pool.slots[c->pred].succ = i;
+            else entity_orphans = i;
+            entity_last_orphan = i;
+        }
+        if (c->name) entity_lookup_add(i);
+    }
+}
+
+void entity_remove(entity_t *e) {
+    if (e) {
+        uint32_t i = e - entity_pool.slots;
+        entity_cold_t *c = &entity_pool.cold[i];
+        if (c->name) entity_lookup_del(i);
+        if (e->parent) {
+            entity_t *p = &entity_pool.slots[e->parent];
+            if(p->children == i) p->children = e->succ;
+            if(ENTITY_COLD(p)->last_child == i) ENTITY_COLD(p)->last_child = c->pred;
+        } else {
+            if(entity_orphans == i) entity_orphans = e->succ;
+            if(entity_last_orphan == i) entity_last_orphan = c->pred;
+        }
+        if(e->succ) entity_pool.cold[e->succ].pred = c->pred;
+        if(c->pred) entity_pool.slots[c->pred].succ = e->succ;
+    }
+}
+
+// FNV-1a
+static inline uint32_t entity_hash_text(const char *text, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t k = 0; k < len; k++) h = (h ^ (uint8_t)text[k])*16777619u;
+    return h;
+}
+
+// interned copy of text[0, len), NULL if it is not interned yet and add is false
+const char *entity_intern(const char *text, size_t len, bool add) {
+    entity_names_t *n = &entity_names;
+    uint32_t mask = n->capacity - 1, k = entity_hash_text(text, len);
+    for (; n->capacity && n->table[k & mask]; k++) {
+        const char *name = n->table[k & mask];
+        if (!strncmp(name, text, len) && !name[len]) return name;
+    }
+    if (!add) return NULL;
+
+    if (2*(n->count + 1) > n->capacity) {
+        uint32_t capacity = (n->capacity) ? n->capacity*2 : 256;
+        const char **table = (const char**)MemAlloc(capacity*sizeof(const char*));
+        if (!table) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity names!"));
+            exit(1);
+        }
+        for (uint32_t j = 0; j < n->capacity; j++) {
+            const char *name = n->table[j];
+            if (!name) continue;
+            uint32_t h = entity_hash_text(name, strlen(name));
+            while (table[h & (capacity - 1)]) h++;
+            table[h & (capacity - 1)] = name;
+        }
+        MemFree(n->table);
+        n->table = table;
+        n->capacity = capacity;
+        mask = capacity - 1;
+        for (k = entity_hash_text(text, len); table[k & mask]; k++);
+    }
+    if (n->used + len + 1 > n->size) {
+        uint32_t size = sizeof(char*) + len + 1;
+        if (size < ENTITY_NAMES_BLOCK) size = ENTITY_NAMES_BLOCK;
+        char *block = (char*)MemAlloc(size);
+        if (!block) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity names!"));
+            exit(1);
+        }
+        memcpy(block, &n->block, sizeof(char*));
+        n->block = block;
+        n->used = sizeof(char*);
+        n->size = size;
+    }
+    char *name = n->block + n->used;
+    memcpy(name, text, len);
+    name[len] = '\0';
+    n->used += len + 1;
+    n->table[k & mask] = name;
+    n->count++;
+    return name;
+}
+
+// slot of an interned name in the intern table
+uint32_t entity_name_slot(const char *name) {
+    uint32_t mask = entity_names.capacity - 1, k = entity_hash_text(name, strlen(name));
+    while (entity_names.table[k & mask] != name) k++;
+    return k & mask;
+}
+
+uint32_t entity_lookup_home(uint32_t parent, const char *name) {
+    uint32_t h = (uint32_t)((uintptr_t)name >> 3)*2654435761u ^ parent*2246822519u;
+    return (h ^ (h >> 15)) & (entity_lookup.capacity - 1);
+}
+
+// index the named entity at slot i under its current parent
+void entity_lookup_add(uint32_t i) {
+    entity_lookup_t *l = &entity_lookup;
+    if (2*(l->count + 1) > l->capacity) {
+        uint32_t *old = l->slots, count = l->capacity;
+        l->capacity = (count) ? count*2 : 256;
+        l->slots = (uint32_t*)MemAlloc(l->capacity*sizeof(uint32_t));
+        if (!l->slots) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity names!"));
+            exit(1);
+        }
+        l->count = 0;
+        for (uint32_t k = 0; k < count; k++) if (old[k]) entity_lookup_add(old[k]);
+        MemFree(old);
+    }
+    uint32_t mask = l->capacity - 1, k = entity_lookup_home(entity_pool.slots[i].parent, entity_pool.cold[i].name);
+    while (l->slots[k]) k = (k + 1) & mask;
+    l->slots[k] = i;
+    l->count++;
+}
+
+// drop slot i from the index (its parent and name must be the indexed ones), shifting back the entries
+// probed past it
+void entity_lookup_del(uint32_t i) {
+    entity_lookup_t *l = &entity_lookup;
+    if (!l->count) return;
+    uint32_t mask = l->capacity - 1, k = entity_lookup_home(entity_pool.slots[i].parent, entity_pool.cold[i].name);
+    while (l->slots[k] && l->slots[k] != i) k = (k + 1) & mask;
+    if (!l->slots[k]) return;
+    for (uint32_t j = (k + 1) & mask; l->slots[j]; j = (j + 1) & mask) {
+        uint32_t h = entity_lookup_home(entity_pool.slots[l->slots[j]].parent, entity_pool.cold[l->slots[j]].name);
+        if (((j - h) & mask) >= ((j - k) & mask)) {
+            l->slots[k] = l->slots[j];
+            k = j;
+        }
+    }
+    l->slots[k] = 0;
+    l->count--;
+}
+
+// slot of the entity at path below parent (ENTITY_NONE: the roots), path starts with a name and may end
+// with '/'; ENTITY_NONE if there is none
+uint32_t entity_lookup_find(uint32_t parent, const char *path) {
+    entity_lookup_t *l = &entity_lookup;
+    const char *end = path, *next;
+    while (*end && *end != '/') end++;
+    for (next = end; *next == '/'; next++);
+    const char *name = entity_intern(path, end - path, false);
+    if (!name || !l->count) return ENTITY_NONE;
+
+    uint32_t mask = l->capacity - 1;
+    for (uint32_t k = entity_lookup_home(parent, name); l->slots[k]; k = (k + 1) & mask) {
+        uint32_t i = l->slots[k];
+        if (entity_pool.slots[i].parent != parent || entity_pool.cold[i].name != name) continue;
+        if (!*next) return i;
+        if ((i = entity_lookup_find(i, next))) return i;
+    }
+    return ENTITY_NONE;
+}
+
+// true (with a warning) if e is static, for the functions writing its transform
+bool entity_frozen(const entity_t *e) {
+    if (!(entity_tforms.dirty[e->tf] & TFORM_STATIC)) return false;
+    TraceLog(LOG_WARNING, TextFormat("static entity 0x%08x can not be moved!", entity_handle(e)));
+    return true;
+}
+
+// monotonic wall time in seconds (clock() is process time, summed over the worker threads)
+double entity_now() {
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// byte offsets of the arrays of a scene file of count entities and a name table of names bytes, each on
+// 16 bytes; returns the file size, 0 if it does not fit 32 bits
+uint32_t entity_scene_layout(uint32_t count, uint32_t names, uint32_t *offset) {
+    static const uint32_t stride[SCENE_ARRAYS] = {
+        sizeof(Vector3), sizeof(Quaternion), sizeof(Vector3), sizeof(Vector4), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint8_t), 1
+    };
+    uint64_t at = sizeof(entity_scene_header_t);
+    for (int k = 0; k < SCENE_ARRAYS; k++) {
+        at = (at + 15) & ~(uint64_t)15;
+        offset[k] = (uint32_t)at;
+        at += (uint64_t)stride[k]*((k == SCENE_NAMES) ? names : count);
+        if (at > UINT32_MAX) return 0;
+    }
+    return (uint32_t)at;
+}
+
+// bring the visible/enabled membership of e and its subtree up to date after a flag or parent change,
+// walking down only while membership changes
+void entity_refresh_sets(entity_t *e) {
+    entity_set_t *sets[2] = {&entity_visible, &entity_enabled};
+    uint32_t root = e - entity_pool.slots;
+    for (int k = 0; k < 2; k++) {
+        entity_set_t *set = sets[k];
+        uint32_t i = root;
+        for (;;) {
+            entity_t *n = &entity_pool.slots[i];
+            bool own = (k == 0) ? entity_pool.cold[i].visible : entity_pool.cold[i].enabled;
+            bool in = own && (!n->parent || (n->parent < set->slots && set->at[n->parent]));
+            bool was = i < set->slots && set->at[i];
+            if (in != was) {
+                if (in) entity_set_add(set, i);
+                else entity_set_del(set, i);
+                if (n->children) { i = n->children; continue; }
+            }
+            while (i != root && !entity_pool.slots[i].succ) i = entity_pool.slots[i].parent;
+            if (i == root) break;
+            i = entity_pool.slots[i].succ;
+        }
+    }
+}
+
+// add a new entity at slot i to the sets its own flags and its parent's membership allow, when entities
+// are created parents first so that the parent's membership is already known
+void entity_join_sets(uint32_t i) {
+    entity_cold_t *c = &entity_pool.cold[i];
+    uint32_t q = entity_pool.slots[i].parent;
+    if (c->visible && (!q || (q < entity_visible.slots && entity_visible.at[q]))) entity_set_add(&entity_visible, i);
+    if (c->enabled && (!q || (q < entity_enabled.slots && entity_enabled.at[q]))) entity_set_add(&entity_enabled, i);
+}
+
+void entity_set_add(entity_set_t *set, uint32_t i) {
+    if (i >= set->slots) {
+        uint32_t slots = entity_pool.capacity;
+        set->at = (uint32_t*)MemRealloc(set->at, slots*sizeof(uint32_t));
+        if (!set->at) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity sets!"));
+            exit(1);
+        }
+        memset(set->at + set->slots, 0, (slots - set->slots)*sizeof(uint32_t));
+        set->slots = slots;
+    }
+    if (set->at[i]) return;
+    if (set->count == set->capacity) {
+        set->capacity = (set->capacity) ? set->capacity*2 : 64;
+        set->items = (uint32_t*)MemRealloc(set->items, set->capacity*sizeof(uint32_t));
+        if (!set->items) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity sets!"));
+            exit(1);
+        }
+    }
+    set->items[set->count++] = i;
+    set->at[i] = set->count;
+}
+
+// swap the last item into the hole
+void entity_set_del(entity_set_t *set, uint32_t i) {
+    if (i >= set->slots || !set->at[i]) return;
+    uint32_t last = set->items[--set->count];
+    set->items[set->at[i] - 1] = last;
+    set->at[last] = set->at[i];
+    set->at[i] = 0;
+}
+
+int entity_set_enum(const entity_set_t *set, entity_id_t e, entity_id_t *out, int max) {
+    int n = 0;
+    if (e == ENTITY_NONE) {
+        for (uint32_t k = 0; k < set->count; k++, n++)
+            if (n < max) out[n] = entity_handle(&entity_pool.slots[set->items[k]]);
+        return n;
+    }
+    entity_t *r = entity_get(e);
+    if (!r) return 0;
+
+    // scan the subtree range in store order, a subtree out of the set is skipped whole
+    tform_store_t *s = &entity_tforms;
+    if (!s->sorted) tform_sort();
+    for (uint32_t t = r->tf, end = t + s->size[t]; t < end;) {
+        uint32_t i = s->owner[t];
+        if (i < set->slots && set->at[i]) {
+            if (n < max) out[n] = entity_handle(&entity_pool.slots[i]);
+            n++;
+            t++;
+        } else {
+            t += s->size[t];
+        }
+    }
+    return n;
+}
+
+// O(1): flag the transform and record it as a dirty root, descendants are reached by the next pass
+void entity_invalidate_tform(entity_t *e) {
+    uint8_t *dirty = &entity_tforms.dirty[e->tf];
+    *dirty |= TFORM_DIRTY_WORLD;
+    if (*dirty & TFORM_DIRTY_QUEUED) return;
+    *dirty |= TFORM_DIRTY_QUEUED;
+
+    tform_dirty_set_t *d = &entity_dirty;
+    if (d->count == d->capacity) {
+        uint32_t capacity = (d->capacity) ? d->capacity*2 : 64;
+        d->roots = (uint32_t*)MemRealloc(d->roots, capacity*sizeof(uint32_t));
+        d->ranges = (tform_task_t*)MemRealloc(d->ranges, capacity*sizeof(tform_task_t));
+        if (!d->roots || !d->ranges) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for dirty entities!"));
+            exit(1);
+        }
+        d->capacity = capacity;
+    }
+    d->roots[d->count++] = entity_handle(e);
+}
+
+void entity_turn(entity_id_t e, Quaternion rot, tform_space_t global) {
+    global ?
+    entity_set_rotation(e, QuaternionMultiply(rot, entity_get_rotation(e, TFORM_WORLD)), TFORM_WORLD):
+    entity_set_rotation(e, QuaternionMultiply(entity_get_rotation(e, TFORM_LOCAL), rot), TFORM_LOCAL);
+}
+
+// append a command, the buffer only belongs to the calling thread so no lock is taken
+entity_cmd_t *entity_cmd_push(entity_cmds_t *c, entity_cmd_op_t op, entity_id_t e) {
+    if (c->count == c->capacity) {
+        uint32_t capacity = (c->capacity) ? c->capacity*2 : ENTITY_CMDS_MIN;
+        entity_cmd_t *items = (entity_cmd_t*)MemRealloc(c->items, capacity*sizeof(entity_cmd_t));
+        if (!items) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity commands!"));
+            exit(1);
+        }
+        c->items = items;
+        c->capacity = capacity;
+    }
+    entity_cmd_t *cmd = &c->items[c->count++];
+    *cmd = (entity_cmd_t){0};
+    cmd->op = (uint8_t)op;
+    cmd->e = e;
+    return cmd;
+}
+
+// replay the commands [begin, end) of c, all of the same operation: creations reserve the pool and the
+// store once, long runs of structural changes leave the store to a single tform_sort instead of
+// patching it per command
+void entity_cmds_run(entity_cmds_t *c, uint32_t begin, uint32_t end) {
+    entity_cmd_t *cmd = c->items;
+    uint32_t n = end - begin;
+    entity_cmd_op_t op = (entity_cmd_op_t)cmd[begin].op;
+    if (op == ENTITY_CMD_CREATE) {
+        tform_store_t *s = &entity_tforms;
+        entity_reserve(entity_pool.count + n);
+        if (s->count + n > s->capacity) {
+            uint32_t capacity = (s->capacity) ? s->capacity : TFORM_STORE_MIN;
+            while (capacity < s->count + n) capacity *= 2;
+            tform_reserve(s, capacity);
+        }
+    } else if ((op == ENTITY_CMD_FREE || op == ENTITY_CMD_SET_PARENT) && n*TFORM_SPLICE_MAX > entity_tforms.count) {
+        entity_tforms.sorted = false;
+    }
+
+    for (uint32_t k = begin; k < end; k++) {
+        entity_id_t e = entity_cmds_resolve(c, cmd[k].e);
+        Vector4 v = cmd[k].v;
+        switch (op) {
+            case ENTITY_CMD_CREATE: c->resolved[cmd[k].e - 1] = create_entity(); break;
+            case ENTITY_CMD_FREE: free_entity(e); break;
+            case ENTITY_CMD_SET_PARENT: entity_set_parent(e, entity_cmds_resolve(c, cmd[k].p)); break;
+            case ENTITY_CMD_POSITION: entity_set_position(e, (Vector3){v.x, v.y, v.z}, cmd[k].global); break;
+            case ENTITY_CMD_ROTATE: entity_set_rotation(e, v, cmd[k].global); break;
+            case ENTITY_CMD_TURN: entity_turn(e, v, cmd[k].global); break;
+            case ENTITY_CMD_SCALE: entity_set_scale(e, (Vector3){v.x, v.y, v.z}, cmd[k].global); break;
+            case ENTITY_CMD_MOVE: move_entity(e, v.x, v.y, v.z); break;
+        }
+    }
+}
+
+// append a root transform, appending keeps the store ordered since a new entity has no parent yet
+uint32_t tform_alloc(uint32_t owner) {
+    tform_store_t *s = &entity_tforms;
+    if (s->count == s->capacity) tform_reserve(s, (s->capacity) ? s->capacity*2 : TFORM_STORE_MIN);
+    if (!s->count) {
+        s->count = 1; // index 0 is unused
+        s->sorted = true;
+    }
+    uint32_t t = s->count++;
+    s->pos[t] = Vector3Zero();
+    s->scale[t] = Vector3One();
+    s->rot[t] = QuaternionIdentity();
+    s->bounds[t] = (Vector4){0};
+    s->tree_box[t] = (BoundingBox){{INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}};
+    s->parent[t] = 0;
+    s->size[t] = 1;
+    s->owner[t] = owner;
+    s->dirty[t] = TFORM_TREE_UNBOUNDED;
+    return t;
+}
+
+// append n transforms to the sorted store, each with a new entity slot (pool and store grown once), and
+// return the index of the first one; the caller fills the block in pre-order
+uint32_t tform_append_block(uint32_t n) {
+    tform_store_t *s = &entity_tforms;
+    if (!s->count) {
+        s->count = 1; // index 0 is unused
+        s->sorted = true;
+    }
+    uint32_t c = s->count;
+    entity_reserve(entity_pool.count + n);
+    if (c + n > s->capacity) {
+        uint32_t capacity = (s->capacity) ? s->capacity : TFORM_STORE_MIN;
+        while (capacity < c + n) capacity *= 2;
+        tform_reserve(s, capacity);
+    }
+    for (uint32_t k = 0; k < n; k++) s->owner[c + k] = entity_alloc();
+    s->count = c + n;
+    return c;
+}
+
+void tform_reserve(tform_store_t *s, uint32_t capacity) {
+    s->pos = (Vector3*)MemRealloc(s->pos, capacity*sizeof(Vector3));
+    s->scale = (Vector3*)MemRealloc(s->scale, capacity*sizeof(Vector3));
+    s->rot = (Quaternion*)MemRealloc(s->rot, capacity*sizeof(Quaternion));
+    s->world = (Matrix*)MemRealloc(s->world, capacity*sizeof(Matrix));
+    s->world_rot = (Quaternion*)MemRealloc(s->world_rot, capacity*sizeof(Quaternion));
+    s->world_scale = (Vector3*)MemRealloc(s->world_scale, capacity*sizeof(Vector3));
+    s->bounds = (Vector4*)MemRealloc(s->bounds, capacity*sizeof(Vector4));
+    s->tree_box = (BoundingBox*)MemRealloc(s->tree_box, capacity*sizeof(BoundingBox));
+    s->parent = (uint32_t*)MemRealloc(s->parent, capacity*sizeof(uint32_t));
+    s->size = (uint32_t*)MemRealloc(s->size, capacity*sizeof(uint32_t));
+    s->owner = (uint32_t*)MemRealloc(s->owner, capacity*sizeof(uint32_t));
+    s->dirty = (uint8_t*)MemRealloc(s->dirty, capacity*sizeof(uint8_t));
+    if (!s->pos || !s->scale || !s->rot || !s->world || !s->world_rot || !s->world_scale || !s->bounds || !s->tree_box ||
+        !s->parent || !s->size || !s->owner || !s->dirty) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity transforms!"));
+        exit(1);
+    }
+    s->capacity = capacity;
+}
+
+// leave a hole, it is squeezed out by the next tform_sort
+void tform_release(uint32_t t) {
+    entity_tforms.owner[t] = ENTITY_NONE;
+    entity_tforms.dirty[t] = 0;
+    entity_tforms.sorted = false;
+}
+
+// rebuild the store in hierarchy pre-order (parents first, no holes) in place: number the transforms in
+// pre-order, apply that permutation, then recount the subtree sizes bottom-up
+void tform_sort() {
+    tform_store_t *s = &entity_tforms;
+    uint32_t *src = (uint32_t*)MemAlloc(s->count*sizeof(uint32_t)), k = 1; // source of index k at k - 1
+    if (!src) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory to sort entity transforms!"));
+        exit(1);
+    }
+    for (uint32_t r = entity_orphans; r; r = entity_pool.slots[r].succ) {
+        uint32_t i = r;
+        for (;;) {
+            entity_t *e = &entity_pool.slots[i];
+            src[k - 1] = e->tf;
+            e->tf = k++;
+
+            // next node in pre-order within the root subtree
+            if (e->children) { i = e->children; continue; }
+            while (i != r && !entity_pool.slots[i].succ) i = entity_pool.slots[i].parent;
+            if (i == r) break;
+            i = entity_pool.slots[i].succ;
+        }
+    }
+    uint32_t live = k;
+    for (uint32_t t = 1; t < s->count; t++) if (!s->owner[t]) src[k++ - 1] = t; // holes go to the end
+    tform_permute(s, src, 1, s->count);
+    MemFree(src);
+
+    s->count = live;
+    for (uint32_t t = 1; t < live; t++) {
+        entity_t *e = &entity_pool.slots[s->owner[t]];
+        s->parent[t] = (e->parent) ? entity_pool.slots[e->parent].tf : 0;
+        s->size[t] = 1;
+    }
+    for (uint32_t t = live - 1; t > 0; t--) if (s->parent[t]) s->size[s->parent[t]] += s->size[t];
+    s->sorted = true;
+}
+
+// move every transform of [begin, end) from its index in src (the one of t at src[t - begin], used up),
+// following each cycle of the permutation with the unused index 0 as temporary
+void tform_permute(tform_store_t *s, uint32_t *src, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        if (!src[i - begin] || src[i - begin] == i) continue;
+        tform_move(s, 0, i);
+        for (uint32_t t = i;;) {
+            uint32_t from = src[t - begin];
+            src[t - begin] = 0;
+            if (from == i) { tform_move(s, t, 0); break; }
+            tform_move(s, t, from);
+            t = from;
+        }
+    }
+}
+
+void tform_move(tform_store_t *s, uint32_t dst, uint32_t src) {
+    s->pos[dst] = s->pos[src];
+    s->scale[dst] = s->scale[src];
+    s->rot[dst] = s->rot[src];
+    s->world[dst] = s->world[src];
+    s->parent[dst] = s->parent[src];
+    s->size[dst] = s->size[src];
+    s->dirty[dst] = s->dirty[src];
+    s->world_rot[dst] = s->world_rot[src];
+    s->world_scale[dst] = s->world_scale[src];
+    s->bounds[dst] = s->bounds[src];
+    s->tree_box[dst] = s->tree_box[src];
+    s->owner[dst] = s->owner[src];
+}
+
+// same as tform_move on n consecutive transforms (ranges may overlap)
+void tform_move_range(tform_store_t *s, uint32_t dst, uint32_t src, uint32_t n) {
+    memmove(&s->pos[dst], &s->pos[src], n*sizeof(Vector3));
+    memmove(&s->scale[dst], &s->scale[src], n*sizeof(Vector3));
+    memmove(&s->rot[dst], &s->rot[src], n*sizeof(Quaternion));
+    memmove(&s->world[dst], &s->world[src], n*sizeof(Matrix));
+    memmove(&s->parent[dst], &s->parent[src], n*sizeof(uint32_t));
+    memmove(&s->size[dst], &s->size[src], n*sizeof(uint32_t));
+    memmove(&s->dirty[dst], &s->dirty[src], n*sizeof(uint8_t));
+    memmove(&s->world_rot[dst], &s->world_rot[src], n*sizeof(Quaternion));
+    memmove(&s->world_scale[dst], &s->world_scale[src], n*sizeof(Vector3));
+    memmove(&s->bounds[dst], &s->bounds[src], n*sizeof(Vector4));
+    memmove(&s->tree_box[dst], &s->tree_box[src], n*sizeof(BoundingBox));
+    memmove(&s->owner[dst], &s->owner[src], n*sizeof(uint32_t));
+}
+
+// patch the sorted store after the entity of t became the last child of the entity of p (0 for a root):
+// the range of t and the span between it and its new place are rotated, returns false (store untouched)
+// when that span is longer than TFORM_SPLICE_MAX
+bool tform_splice(uint32_t t, uint32_t p) {
+    tform_store_t *s = &entity_tforms;
+    uint32_t n = s->size[t], end = t + n;
+    uint32_t dst = (p) ? p + s->size[p] : s->count;
+    if (p >= t && p < end) return false;
+    uint32_t lo = (dst < t) ? dst : t, hi = (dst < t) ? end : dst;
+    bool moved = dst < t || dst > end;
+    if (moved && hi - lo > TFORM_SPLICE_MAX) return false;
+
+    for (uint32_t a = s->parent[t]; a; a = s->parent[a]) s->size[a] -= n;
+    for (uint32_t a = p; a; a = s->parent[a]) s->size[a] += n;
+    if (!moved) {
+        s->parent[t] = p;
+        return true;
+    }
+
+    // only the ancestors spanning the end of the rotated span (the old ones of t when moving backward,
+    // the new ones when moving forward) may have children after it, their parent index is fixed below
+    uint32_t m = 0;
+    for (uint32_t a = (dst < t) ? s->parent[t] : p; a >= lo; a = s->parent[a]) {
+        if (a >= hi) continue;
+        for (uint32_t c = entity_pool.cold[s->owner[a]].last_child; c && entity_pool.slots[c].tf >= hi; c = entity_pool.cold[c].pred)
+            m = tform_path_push(m, c);
+    }
+
+    uint32_t src[TFORM_SPLICE_MAX];
+    for (uint32_t k = lo; k < hi; k++) {
+        if (dst < t) src[k - lo] = (k < lo + n) ? t + (k - lo) : k - n;
+        else src[k - lo] = (k < hi - n) ? k + n : t + (k - (hi - n));
+    }
+    tform_permute(s, src, lo, hi);
+    for (uint32_t k = lo; k < hi; k++) entity_pool.slots[s->owner[k]].tf = k;
+    for (uint32_t k = lo; k < hi; k++) {
+        entity_t *e = &entity_pool.slots[s->owner[k]];
+        s->parent[k] = (e->parent) ? entity_pool.slots[e->parent].tf : 0;
+    }
+    for (uint32_t k = 0; k < m; k++) {
+        entity_t *e = &entity_pool.slots[entity_dirty.path[k]];
+        s->parent[e->tf] = entity_pool.slots[e->parent].tf;
+    }
+    return true;
+}
+
+// close the gap left by the released range of t in the sorted store by moving the transforms after it
+// down, array by array; returns false (store untouched) when more than TFORM_SPLICE_MAX transforms, and
+// more than were released, would move: a large subtree pays for moving a tail up to its own size
+bool tform_cut(uint32_t t) {
+    tform_store_t *s = &entity_tforms;
+    uint32_t n = s->size[t], end = t + n, tail = s->count - end;
+    if (tail > TFORM_SPLICE_MAX && tail > n) return false;
+
+    for (uint32_t a = s->parent[t]; a; a = s->parent[a]) s->size[a] -= n;
+    tform_move_range(s, t, end, tail);
+    for (uint32_t k = t; k < t + tail; k++) {
+        if (s->parent[k] >= end) s->parent[k] -= n;
+        entity_pool.slots[s->owner[k]].tf = k;
+    }
+    s->count -= n;
+    return true;
+}
+
+Matrix tform_local(uint32_t t) {
+    tform_store_t *s = &entity_tforms;
+    return tform_compose(s->pos[t], s->rot[t], s->scale[t]);
+}
+
+// only dirty roots are flagged, so a world matrix is stale while roots queued since the last resolution
+// are pending: resolve their ranges once, then reads are plain loads until the next write; an unsorted
+// store has no ranges, recompute the path below the topmost flagged ancestor (flags stay) instead
+Matrix tform_world(uint32_t t) {
+    tform_store_t *s = &entity_tforms;
+    tform_dirty_set_t *d = &entity_dirty;
+    if (d->resolved == d->count || (s->dirty[t] & TFORM_STATIC)) return s->world[t];
+    if (s->sorted) {
+        tform_resolve_pending();
+        return s->world[t];
+    }
+
+    // a static ancestor is final, nothing above it matters
+    uint32_t n = 0, top = 0;
+    for (uint32_t a = t; a && !(s->dirty[a] & TFORM_STATIC); a = s->parent[a]) {
+        n = tform_path_push(n, a);
+        if (s->dirty[a] & TFORM_DIRTY_WORLD) top = n;
+    }
+    while (top) {
+        uint32_t a = d->path[--top];
+        Matrix local = tform_local(a);
+        tform_combine(s, a, &local);
+        s->dirty[a] &=~TFORM_INVERSE_CACHED;
+    }
+    return s->world[t];
+}
+
+// resolve the ranges of the roots queued since the last resolution like a pass does (disjoint, in store
+// order, so every parent is resolved first), without their bounds: the roots stay queued for the next pass
+void tform_resolve_pending() {
+    tform_store_t *s = &entity_tforms;
+    tform_dirty_set_t *d = &entity_dirty;
+    uint32_t n = 0;
+    for (uint32_t i = d->resolved; i < d->count; i++) {
+        entity_t *e = (entity_is_valid(d->roots[i])) ? &entity_pool.slots[d->roots[i] & ENTITY_INDEX_MASK] : NULL;
+        if (e && (s->dirty[e->tf] & TFORM_DIRTY_QUEUED)) d->ranges[n++] = (tform_task_t){e->tf, e->tf + s->size[e->tf]};
+    }
+    d->resolved = d->count;
+    if (n > 1) qsort(d->ranges, n, sizeof(tform_task_t), tform_range_compare);
+    for (uint32_t i = 0, end = 0; i < n; i++) {
+        if (d->ranges[i].begin < end) continue;
+        tform_update_range(d->ranges[i].begin, d->ranges[i].end);
+        end = d->ranges[i].end;
+    }
+}
+
+// world matrix, rotation and scale of t from its local transform and its resolved parent
+void tform_combine(tform_store_t *s, uint32_t t, const Matrix *local) {
+    uint32_t p = s->parent[t];
+    if (p) {
+        s->world[t] = tform_multiply(*local, s->world[p]);
+        s->world_rot[t] = QuaternionMultiply(s->world_rot[p], s->rot[t]);
+        s->world_scale[t] = Vector3Multiply(s->world_scale[p], s->scale[t]);
+    } else {
+        s->world[t] = *local;
+        s->world_rot[t] = s->rot[t];
+        s->world_scale[t] = s->scale[t];
+    }
+}
+
+Matrix tform_world_inverse(uint32_t t) {
+    tform_store_t *s = &entity_tforms;
+    tform_inverse_cache_t *c = &entity_inverses;
+    if (!c->inv) {
+        c->inv = (Matrix*)MemAlloc(TFORM_INVERSE_CACHE*sizeof(Matrix));
+        c->slot = (uint32_t*)MemAlloc(TFORM_INVERSE_CACHE*sizeof(uint32_t));
+        if (!c->inv || !c->slot) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity inverses!"));
+            exit(1);
+        }
+        for (uint32_t k = 0; k < TFORM_INVERSE_CACHE; k++) c->slot[k] = ENTITY_NONE;
+    }
+    Matrix world = tform_world(t); // resolving clears the flag of a stale inverse
+    uint32_t slot = s->owner[t], k = slot & (TFORM_INVERSE_CACHE - 1);
+    if ((s->dirty[t] & TFORM_INVERSE_CACHED) && c->slot[k] == slot) return c->inv[k];
+    c->inv[k] = tform_affine_inverse(world);
+    c->slot[k] = slot;
+    s->dirty[t] |= TFORM_INVERSE_CACHED;
+    return c->inv[k];
+}
+
+// inverse of a transform without projection (m3, m7, m11 = 0, m15 = 1): invert the 3x3 part with
+// its cofactors, then bring the translation back through it, a fraction of MatrixInvert's work
+Matrix tform_affine_inverse(Matrix m) {
+    float c00 = m.m5*m.m10 - m.m6*m.m9, c01 = m.m6*m.m8 - m.m4*m.m10, c02 = m.m4*m.m9 - m.m5*m.m8;
+    float det = m.m0*c00 + m.m1*c01 + m.m2*c02;
+    float inv = (det != 0.f) ? 1.f/det : 0.f;
+    Matrix r = { 0 };
+    r.m0 = c00*inv;
+    r.m1 = (m.m2*m.m9 - m.m1*m.m10)*inv;
+    r.m2 = (m.m1*m.m6 - m.m2*m.m5)*inv;
+    r.m4 = c01*inv;
+    r.m5 = (m.m0*m.m10 - m.m2*m.m8)*inv;
+    r.m6 = (m.m2*m.m4 - m.m0*m.m6)*inv;
+    r.m8 = c02*inv;
+    r.m9 = (m.m1*m.m8 - m.m0*m.m9)*inv;
+    r.m10 = (m.m0*m.m5 - m.m1*m.m4)*inv;
+    r.m12 = -(m.m12*r.m0 + m.m13*r.m4 + m.m14*r.m8);
+    r.m13 = -(m.m12*r.m1 + m.m13*r.m5 + m.m14*r.m9);
+    r.m14 = -(m.m12*r.m2 + m.m13*r.m6 + m.m14*r.m10);
+    r.m15 = 1.f;
+    return r;
+}
+
+// Get transform matrix (rotation -> scale -> translation) straight from the unit quaternion,
+// same result as MatrixMultiply(MatrixMultiply(scl, rot), pos) without the axis/angle round trip
+Matrix tform_compose(Vector3 pos, Quaternion q, Vector3 scale) {
+    float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+    float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+    float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+    return (Matrix){
+        scale.x*(1.f - 2.f*(yy + zz)), scale.y*(2.f*(xy - wz)), scale.z*(2.f*(xz + wy)), pos.x,
+        scale.x*(2.f*(xy + wz)), scale.y*(1.f - 2.f*(xx + zz)), scale.z*(2.f*(yz - wx)), pos.y,
+        scale.x*(2.f*(xz - wy)), scale.y*(2.f*(yz + wx)), scale.z*(1.f - 2.f*(xx + yy)), pos.z,
+        0.f, 0.f, 0.f, 1.f
+    };
+}
+
+// same operation order as MatrixMultiply, so both paths give bit-identical results
+Matrix tform_multiply(Matrix left, Matrix right) {
+#if TFORM_LANES > 1
+    Matrix out;
+    const float *l = &left.m0, *r = &right.m0;
+    float *o = &out.m0;
+    __m128 l0 = _mm_loadu_ps(l), l1 = _mm_loadu_ps(l + 4), l2 = _mm_loadu_ps(l + 8), l3 = _mm_loadu_ps(l + 12);
+    for (int i = 0; i < 16; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_set1_ps(r[i]), l0);
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(r[i + 1]), l1));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(r[i + 2]), l2));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(r[i + 3]), l3));
+        _mm_storeu_ps(o + i, v);
+    }
+    return out;
+#else
+    return MatrixMultiply(left, right);
+#endif
+}
+
+#if TFORM_LANES > 1
+// write 4 local matrices to out given one register per matrix element
+static void tform_store4(Matrix *out,
+    __m128 m0, __m128 m1, __m128 m2, __m128 m4, __m128 m5, __m128 m6,
+    __m128 m8, __m128 m9, __m128 m10, __m128 px, __m128 py, __m128 pz) {
+    __m128 m3 = _mm_setzero_ps(), m7 = m3, m11 = m3, m15 = _mm_set1_ps(1.f);
+    _MM_TRANSPOSE4_PS(m0, m4, m8, px);
+    _MM_TRANSPOSE4_PS(m1, m5, m9, py);
+    _MM_TRANSPOSE4_PS(m2, m6, m10, pz);
+    _MM_TRANSPOSE4_PS(m3, m7, m11, m15);
+
+    __m128 rows[4][4] = {{m0, m1, m2, m3}, {m4, m5, m6, m7}, {m8, m9, m10, m11}, {px, py, pz, m15}};
+    for (int k = 0; k < 4; k++) {
+        float *o = &out[k].m0;
+        for (int r = 0; r < 4; r++) _mm_storeu_ps(o + 4*r, rows[k][r]);
+    }
+}
+
+// tform_compose on 4 transforms at once, one transform per lane
+static void tform_compose4(const tform_store_t *s, const uint32_t *idx, Matrix *out) {
+    const __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+    __m128 qx = _mm_loadu_ps(&s->rot[idx[0]].x), qy = _mm_loadu_ps(&s->rot[idx[1]].x);
+    __m128 qz = _mm_loadu_ps(&s->rot[idx[2]].x), qw = _mm_loadu_ps(&s->rot[idx[3]].x);
+    _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+    __m128 sx = _mm_set_ps(s->scale[idx[3]].x, s->scale[idx[2]].x, s->scale[idx[1]].x, s->scale[idx[0]].x);
+    __m128 sy = _mm_set_ps(s->scale[idx[3]].y, s->scale[idx[2]].y, s->scale[idx[1]].y, s->scale[idx[0]].y);
+    __m128 sz = _mm_set_ps(s->scale[idx[3]].z, s->scale[idx[2]].z, s->scale[idx[1]].z, s->scale[idx[0]].z);
+    __m128 px = _mm_set_ps(s->pos[idx[3]].x, s->pos[idx[2]].x, s->pos[idx[1]].x, s->pos[idx[0]].x);
+    __m128 py = _mm_set_ps(s->pos[idx[3]].y, s->pos[idx[2]].y, s->pos[idx[1]].y, s->pos[idx[0]].y);
+    __m128 pz = _mm_set_ps(s->pos[idx[3]].z, s->pos[idx[2]].z, s->pos[idx[1]].z, s->pos[idx[0]].z);
+
+    __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+    __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+    __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+    // one register per matrix element
+    __m128 m0 = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+    __m128 m1 = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, wz)));
+    __m128 m2 = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, wy)));
+    __m128 m4 = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, wz)));
+    __m128 m5 = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+    __m128 m6 = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, wx)));
+    __m128 m8 = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, wy)));
+    __m128 m9 = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, wx)));
+    __m128 m10 = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+    tform_store4(out, m0, m1, m2, m4, m5, m6, m8, m9, m10, px, py, pz);
+}
+#endif
+
+#if TFORM_LANES > 4
+// tform_compose on 8 transforms at once, one transform per lane
+static void tform_compose8(const tform_store_t *s, const uint32_t *idx, Matrix *out) {
+    const __m256 one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f);
+    __m256 qx, qy, qz, qw, sx, sy, sz, px, py, pz;
+    float lane[10][8];
+    for (int k = 0; k < 8; k++) {
+        Quaternion q = s->rot[idx[k]];
+        Vector3 sc = s->scale[idx[k]], p = s->pos[idx[k]];
+        lane[0][k] = q.x; lane[1][k] = q.y; lane[2][k] = q.z; lane[3][k] = q.w;
+        lane[4][k] = sc.x; lane[5][k] = sc.y; lane[6][k] = sc.z;
+        lane[7][k] = p.x; lane[8][k] = p.y; lane[9][k] = p.z;
+    }
+    qx = _mm256_loadu_ps(lane[0]); qy = _mm256_loadu_ps(lane[1]); qz = _mm256_loadu_ps(lane[2]); qw = _mm256_loadu_ps(lane[3]);
+    sx = _mm256_loadu_ps(lane[4]); sy = _mm256_loadu_ps(lane[5]); sz = _mm256_loadu_ps(lane[6]);
+    px = _mm256_loadu_ps(lane[7]); py = _mm256_loadu_ps(lane[8]); pz = _mm256_loadu_ps(lane[9]);
+
+    __m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+    __m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+    __m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+
+    __m256 m[12] = {
+        _mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)))),
+        _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, wz))),
+        _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, wy))),
+        _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, wz))),
+        _mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)))),
+        _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, wx))),
+        _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, wy))),
+        _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, wx))),
+        _mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)))),
+        px, py, pz
+    };
+
+    // store each half through the 4 lanes transpose
+    __m128 lo[12], hi[12];
+    for (int k = 0; k < 12; k++) {
+        lo[k] = _mm256_castps256_ps128(m[k]);
+        hi[k] = _mm256_extractf128_ps(m[k], 1);
+    }
+    tform_store4(out, lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7], lo[8], lo[9], lo[10], lo[11]);
+    tform_store4(out + 4, hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7], hi[8], hi[9], hi[10], hi[11]);
+}
+#endif
+
+// resolve every transform of [begin, end), every parent is either inside the range or already resolved,
+// TFORM_CHUNK transforms at a time: their local matrices are composed, then combined in order
+void tform_update_range(uint32_t begin, uint32_t end) {
+    tform_store_t *s = &entity_tforms;
+    Matrix local[TFORM_CHUNK];
+    uint32_t batch[TFORM_CHUNK];
+    for (uint32_t first = begin; first < end; first += TFORM_CHUNK) {
+        uint32_t last = (end - first > TFORM_CHUNK) ? first + TFORM_CHUNK : end;
+        int n = 0;
+        for (uint32_t t = first; t < last; t++) if (!(s->dirty[t] & TFORM_STATIC)) batch[n++] = t;
+        tform_compose_batch(s, batch, n, local);
+
+        // subtree boxes are left to tform_update_bounds, so they only change with a pass
+        for (uint32_t t = first, k = 0; t < last; t++) {
+            if (s->dirty[t] & TFORM_STATIC) s->dirty[t] &= TFORM_STATIC|TFORM_TREE_UNBOUNDED|TFORM_INVERSE_CACHED;
+            else {
+                tform_combine(s, t, &local[k++]);
+                s->dirty[t] &= TFORM_TREE_UNBOUNDED;
+            }
+        }
+    }
+}
+
+#if defined(ENTITY_THREADS)
+static void tform_jobs_push(tform_worker_t *w, uint32_t begin, uint32_t end) {
+    atomic_fetch_add(&entity_jobs.pending, 1);
+    pthread_mutex_lock(&w->lock);
+    if (w->bottom - w->top == w->capacity) {
+        uint32_t capacity = (w->capacity) ? w->capacity*2 : 64;
+        tform_task_t *tasks = (tform_task_t*)MemAlloc(capacity*sizeof(tform_task_t));
+        if (!tasks) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for entity tasks!"));
+            exit(1);
+        }
+        for (uint32_t i = w->top; i != w->bottom; i++) tasks[i & (capacity - 1)] = w->tasks[i & (w->capacity - 1)];
+        MemFree(w->tasks);
+        w->tasks = tasks;
+        w->capacity = capacity;
+    }
+    w->tasks[w->bottom++ & (w->capacity - 1)] = (tform_task_t){begin, end};
+    pthread_mutex_unlock(&w->lock);
+}
+
+static bool tform_jobs_pop(tform_worker_t *w, tform_task_t *task, bool steal) {
+    bool found = false;
+    pthread_mutex_lock(&w->lock);
+    if (w->bottom != w->top) {
+        *task = (steal) ? w->tasks[w->top++ & (w->capacity - 1)] : w->tasks[--w->bottom & (w->capacity - 1)];
+        found = true;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+// walk the top level subtrees of a task: small ones are batched into linear runs (pushed once
+// they reach the grain, the last one is kept), a large one gets its root resolved and its
+// children pushed as a new task
+static void tform_jobs_process(tform_worker_t *w, tform_task_t task) {
+    if (task.end - task.begin <= TFORM_TASK_GRAIN) {
+        tform_update_range(task.begin, task.end);
+        return;
+    }
+    const tform_store_t *s = &entity_tforms;
+    uint32_t run = task.begin, t = task.begin;
+    while (t < task.end) {
+        uint32_t next = entity_pool.slots[s->owner[t]].succ;
+        next = (next && entity_pool.slots[next].tf < task.end) ? entity_pool.slots[next].tf : task.end;
+        if (next - t > TFORM_TASK_GRAIN) {
+            if (run < t) tform_jobs_push(w, run, t);
+            tform_update_range(t, t + 1);
+            if (t + 1 < next) tform_jobs_push(w, t + 1, next);
+            run = next;
+        } else if (next - run >= TFORM_TASK_GRAIN && next < task.end) {
+            tform_jobs_push(w, run, next);
+            run = next;
+        }
+        t = next;
+    }
+    if (run < task.end) tform_update_range(run, task.end);
+}
+
+// pop own tasks, steal from a random victim when empty, until the round has no task left
+static void tform_jobs_work(tform_worker_t *w) {
+    tform_jobs_t *j = &entity_jobs;
+    tform_task_t task;
+    while (atomic_load(&j->pending) > 0) {
+        bool found = tform_jobs_pop(w, &task, false);
+        for (int tries = 0; !found && tries < j->count; tries++) {
+            w->seed = w->seed*1103515245u + 12345u;
+            tform_worker_t *victim = &j->workers[(w->seed >> 16) % j->count];
+            if (victim != w) found = tform_jobs_pop(victim, &task, true);
+        }
+        if (found) {
+            tform_jobs_process(w, task);
+            atomic_fetch_sub(&j->pending, 1);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+void tform_jobs_run(const tform_task_t *ranges, uint32_t count) {
+    tform_jobs_t *j = &entity_jobs;
+    for (uint32_t i = 0; i < count; i++) tform_jobs_push(&j->workers[0], ranges[i].begin, ranges[i].end);
+    pthread_mutex_lock(&j->lock);
+    j->round++;
+    pthread_cond_broadcast(&j->wake);
+    pthread_mutex_unlock(&j->lock);
+    tform_jobs_work(&j->workers[0]);
+}
+
+void *tform_jobs_main(void *arg) {
+    tform_jobs_t *j = &entity_jobs;
+    tform_worker_t *w = (tform_worker_t*)arg;
+    uint32_t round = 0;
+    pthread_mutex_lock(&j->lock);
+    round = j->round;
+    for (;;) {
+        while (!j->quit && round == j->round) pthread_cond_wait(&j->wake, &j->lock);
+        if (j->quit) break;
+        round = j->round;
+        pthread_mutex_unlock(&j->lock);
+        tform_jobs_work(w);
+        pthread_mutex_lock(&j->lock);
+    }
+    pthread_mutex_unlock(&j->lock);
+    return NULL;
+}
+#endif
+
+// compose the local matrix of n transforms to out, TFORM_LANES transforms per kernel call
+void tform_compose_batch(tform_store_t *s, const uint32_t *idx, int n, Matrix *out) {
+    int k = 0;
+#if TFORM_LANES > 4
+    for (; k + 8 <= n; k += 8) tform_compose8(s, idx + k, out + k);
+#endif
+#if TFORM_LANES > 1
+    for (; k + 4 <= n; k += 4) tform_compose4(s, idx + k, out + k);
+#endif
+    for (; k < n; k++) out[k] = tform_compose(s->pos[idx[k]], s->rot[idx[k]], s->scale[idx[k]]);
+}
+
+// world box of the bounding sphere of a resolved transform, empty if it is unbounded
+BoundingBox tform_own_box(tform_store_t *s, uint32_t t) {
+    if (s->bounds[t].w <= 0.f) return (BoundingBox){{INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}};
+    Vector4 b = tform_sphere(s->bounds[t], &s->world[t]);
+    return (BoundingBox){{b.x - b.w, b.y - b.w, b.z - b.w}, {b.x + b.w, b.y + b.w, b.z + b.w}};
+}
+
+// world bounding sphere of a transform: center through the world matrix, radius by its largest axis scale
+Vector4 tform_world_bounds(uint32_t t) {
+    Matrix m = tform_world(t);
+    return tform_sphere(entity_tforms.bounds[t], &m);
+}
+
+Vector4 tform_sphere(Vector4 b, const Matrix *world) {
+    const Matrix m = *world;
+    float sx = m.m0*m.m0 + m.m1*m.m1 + m.m2*m.m2;
+    float sy = m.m4*m.m4 + m.m5*m.m5 + m.m6*m.m6;
+    float sz = m.m8*m.m8 + m.m9*m.m9 + m.m10*m.m10;
+    return (Vector4){
+        m.m0*b.x + m.m4*b.y + m.m8*b.z + m.m12,
+        m.m1*b.x + m.m5*b.y + m.m9*b.z + m.m13,
+        m.m2*b.x + m.m6*b.y + m.m10*b.z + m.m14,
+        b.w*sqrtf(fmaxf(sx, fmaxf(sy, sz)))
+    };
+}
+
+// test n spheres against the 6 frustum planes, a sphere is out once it is fully behind any plane
+void tform_cull_batch(tform_cull_t *c, const Vector4 *planes, uint32_t n) {
+    uint32_t k = 0;
+#if TFORM_LANES > 4
+    for (; k + 8 <= n; k += 8) {
+        __m256 x = _mm256_loadu_ps(c->x + k), y = _mm256_loadu_ps(c->y + k), z = _mm256_loadu_ps(c->z + k);
+        __m256 r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(c->r + k));
+        __m256 out = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].x), x), _mm256_mul_ps(_mm256_set1_ps(planes[p].y), y)),
+                                     _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].z), z), _mm256_set1_ps(planes[p].w)));
+            out = _mm256_or_ps(out, _mm256_cmp_ps(d, r, _CMP_LT_OQ));
+        }
+        int mask = _mm256_movemask_ps(out);
+        for (int j = 0; j < 8; j++) c->in[k + j] = !((mask >> j) & 1);
+    }
+#endif
+#if TFORM_LANES > 1
+    for (; k + 4 <= n; k += 4) {
+        __m128 x = _mm_loadu_ps(c->x + k), y = _mm_loadu_ps(c->y + k), z = _mm_loadu_ps(c->z + k);
+        __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(c->r + k));
+        __m128 out = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), x), _mm_mul_ps(_mm_set1_ps(planes[p].y), y)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), z), _mm_set1_ps(planes[p].w)));
+            out = _mm_or_ps(out, _mm_cmplt_ps(d, r));
+        }
+        int mask = _mm_movemask_ps(out);
+        for (int j = 0; j < 4; j++) c->in[k + j] = !((mask >> j) & 1);
+    }
+#endif
+    for (; k < n; k++) {
+        bool in = true;
+        for (int p = 0; p < 6 && in; p++)
+            in = (planes[p].x*c->x[k] + planes[p].y*c->y[k]) + (planes[p].z*c->z[k] + planes[p].w) >= -c->r[k];
+        c->in[k] = in;
+    }
+}
+
+// frustum planes (Gribb/Hartmann) from the rows of the clip matrix, normalized, normals point inside
+void tform_frustum(Matrix viewproj, Vector4 *planes) {
+    Matrix m = viewproj;
+    planes[0] = (Vector4){m.m3 + m.m0, m.m7 + m.m4, m.m11 + m.m8, m.m15 + m.m12};   // left
+    planes[1] = (Vector4){m.m3 - m.m0, m.m7 - m.m4, m.m11 - m.m8, m.m15 - m.m12};   // right
+    planes[2] = (Vector4){m.m3 + m.m1, m.m7 + m.m5, m.m11 + m.m9, m.m15 + m.m13};   // bottom
+    planes[3] = (Vector4){m.m3 - m.m1, m.m7 - m.m5, m.m11 - m.m9, m.m15 - m.m13};   // top
+    planes[4] = (Vector4){m.m3 + m.m2, m.m7 + m.m6, m.m11 + m.m10, m.m15 + m.m14};  // near
+    planes[5] = (Vector4){m.m3 - m.m2, m.m7 - m.m6, m.m11 - m.m10, m.m15 - m.m14};  // far
+    for (int p = 0; p < 6; p++) {
+        float len = sqrtf(planes[p].x*planes[p].x + planes[p].y*planes[p].y + planes[p].z*planes[p].z);
+        if (len > 0.f) planes[p] = (Vector4){planes[p].x/len, planes[p].y/len, planes[p].z/len, planes[p].w/len};
+    }
+}
+
+uint32_t bvh_alloc() {
+    bvh_tree_t *b = &entity_bvh;
+    uint32_t n = b->free_head;
+    if (n) {
+        b->free_head = b->nodes[n].right;
+    } else {
+        if (b->count == b->capacity) {
+            uint32_t capacity = (b->capacity) ? b->capacity*2 : BVH_NODES_MIN;
+            b->nodes = (bvh_node_t*)MemRealloc(b->nodes, capacity*sizeof(bvh_node_t));
+            if (!b->nodes) {
+                TraceLog(LOG_ERROR, TextFormat("unable allocate memory for the spatial index!"));
+                exit(1);
+            }
+            b->capacity = capacity;
+            if (!b->count) b->count = 1; // node 0 is the null node
+        }
+        n = b->count++;
+    }
+    b->nodes[n] = (bvh_node_t){0};
+    return n;
+}
+
+void bvh_release(uint32_t n) {
+    entity_bvh.nodes[n].right = entity_bvh.free_head;
+    entity_bvh.free_head = n;
+}
+
+static float bvh_area(BoundingBox box) {
+    Vector3 d = Vector3Subtract(box.max, box.min);
+    return 2.f*(d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+// plain compares rather than fminf/fmaxf, which are calls where NaN must be handled
+static BoundingBox bvh_union(BoundingBox a, BoundingBox b) {
+    return (BoundingBox){
+        {(a.min.x < b.min.x) ? a.min.x : b.min.x, (a.min.y < b.min.y) ? a.min.y : b.min.y, (a.min.z < b.min.z) ? a.min.z : b.min.z},
+        {(a.max.x > b.max.x) ? a.max.x : b.max.x, (a.max.y > b.max.y) ? a.max.y : b.max.y, (a.max.z > b.max.z) ? a.max.z : b.max.z}
+    };
+}
+
+// refresh box and height of an inner node from its children
+static void bvh_fit(bvh_node_t *nodes, uint32_t a) {
+    bvh_node_t *n = &nodes[a];
+    n->box = bvh_union(nodes[n->left].box, nodes[n->right].box);
+    n->height = 1 + ((nodes[n->left].height > nodes[n->right].height) ? nodes[n->left].height : nodes[n->right].height);
+}
+
+// descend to the sibling of least surface area cost, then pair the leaf with it and fix the ancestors
+void bvh_insert(uint32_t leaf) {
+    bvh_tree_t *b = &entity_bvh;
+    bvh_node_t *nodes = b->nodes;
+    if (!b->root) {
+        b->root = leaf;
+        nodes[leaf].parent = 0;
+        return;
+    }
+
+    BoundingBox box = nodes[leaf].box;
+    uint32_t i = b->root;
+    while (nodes[i].left) {
+        float area = bvh_area(nodes[i].box);
+        float combined = bvh_area(bvh_union(nodes[i].box, box));
+        float cost = 2.f*combined;              // new parent of this node and the leaf
+        float inherit = 2.f*(combined - area);  // growth of the ancestors when descending further
+        float cost_child[2];
+        uint32_t child[2] = {nodes[i].left, nodes[i].right};
+        for (int k = 0; k < 2; k++) {
+            float grown = bvh_area(bvh_union(nodes[child[k]].box, box));
+            cost_child[k] = inherit + ((nodes[child[k]].left) ? grown - bvh_area(nodes[child[k]].box) : grown);
+        }
+        if (cost < cost_child[0] && cost < cost_child[1]) break;
+        i = (cost_child[0] < cost_child[1]) ? child[0] : child[1];
+    }
+
+    uint32_t sibling = i, old = nodes[sibling].parent, p = bvh_alloc();
+    nodes = b->nodes; // may have moved
+    nodes[p].parent = old;
+    nodes[p].left = sibling;
+    nodes[p].right = leaf;
+    nodes[sibling].parent = p;
+    nodes[leaf].parent = p;
+    if (!old) b->root = p;
+    else if (nodes[old].left == sibling) nodes[old].left = p;
+    else nodes[old].right = p;
+
+    for (i = p; i; i = nodes[i].parent) {
+        i = bvh_balance(i);
+        bvh_fit(nodes, i);
+    }
+}
+
+// unpair a leaf from its sibling, the sibling takes the place of their parent
+void bvh_remove(uint32_t leaf) {
+    bvh_tree_t *b = &entity_bvh;
+    bvh_node_t *nodes = b->nodes;
+    if (leaf == b->root) {
+        b->root = 0;
+        return;
+    }
+
+    uint32_t p = nodes[leaf].parent, grand = nodes[p].parent;
+    uint32_t sibling = (nodes[p].left == leaf) ? nodes[p].right : nodes[p].left;
+    nodes[sibling].parent = grand;
+    if (!grand) b->root = sibling;
+    else if (nodes[grand].left == p) nodes[grand].left = sibling;
+    else nodes[grand].right = sibling;
+    bvh_release(p);
+
+    for (uint32_t i = grand; i; i = nodes[i].parent) {
+        i = bvh_balance(i);
+        bvh_fit(nodes, i);
+    }
+}
+
+// rotate the taller grandchild up when the children heights differ by more than one, returns the subtree root
+uint32_t bvh_balance(uint32_t a) {
+    bvh_tree_t *t = &entity_bvh;
+    bvh_node_t *n = t->nodes;
+    if (!n[a].left || n[a].height < 2) return a;
+
+    uint32_t b = n[a].left, c = n[a].right;
+    int balance = n[c].height - n[b].height;
+    if (balance >= -1 && balance <= 1) return a;
+
+    // the taller child takes the place of a, a keeps its other child and the shorter grandchild
+    uint32_t up = (balance > 1) ? c : b;
+    uint32_t f = n[up].left, g = n[up].right;
+    n[up].left = a;
+    n[up].parent = n[a].parent;
+    n[a].parent = up;
+    if (!n[up].parent) t->root = up;
+    else if (n[n[up].parent].left == a) n[n[up].parent].left = up;
+    else n[n[up].parent].right = up;
+
+    uint32_t tall = (n[f].height > n[g].height) ? f : g, low = (tall == f) ? g : f;
+    n[up].right = tall;
+    if (balance > 1) n[a].right = low;
+    else n[a].left = low;
+    n[low].parent = a;
+    bvh_fit(n, a);
+    bvh_fit(n, up);
+    return up;
+}
+
+// bring the leaf of an entity to its current world bounding sphere, returns false when the tree
+// has to take the leaf in: new, or out of its fattened box (refattened then, the tree is left as is)
+bool bvh_fit_leaf(entity_t *e) {
+    Vector4 s = tform_world_bounds(e->tf);
+    BoundingBox tight = {{s.x - s.w, s.y - s.w, s.z - s.w}, {s.x + s.w, s.y + s.w, s.z + s.w}};
+    Vector3 move = Vector3Zero();
+    entity_cold_t *c = ENTITY_COLD(e);
+    if (!c->leaf) {
+        c->leaf = bvh_alloc();
+        entity_bvh.nodes[c->leaf].owner = e - entity_pool.slots;
+        entity_bvh.leaves++;
+    } else {
+        bvh_node_t *n = &entity_bvh.nodes[c->leaf];
+        move = (Vector3){s.x - n->sphere.x, s.y - n->sphere.y, s.z - n->sphere.z};
+        n->sphere = s;
+        if (n->box.min.x <= tight.min.x && n->box.min.y <= tight.min.y && n->box.min.z <= tight.min.z &&
+            n->box.max.x >= tight.max.x && n->box.max.y >= tight.max.y && n->box.max.z >= tight.max.z) return true;
+    }
+    bvh_node_t *n = &entity_bvh.nodes[c->leaf];
+    bool still = entity_tforms.dirty[e->tf] & TFORM_STATIC; // never moves, no slack needed
+    float margin = (still) ? 0.f : BVH_MARGIN + 0.1f*s.w;
+    move = Vector3Scale(move, (still) ? 0.f : BVH_PREDICT);
+    n->sphere = s;
+    n->box = (BoundingBox){
+        {tight.min.x - margin + fminf(move.x, 0.f), tight.min.y - margin + fminf(move.y, 0.f), tight.min.z - margin + fminf(move.z, 0.f)},
+        {tight.max.x + margin + fmaxf(move.x, 0.f), tight.max.y + margin + fmaxf(move.y, 0.f), tight.max.z + margin + fmaxf(move.z, 0.f)}
+    };
+    return false;
+}
+
+// fit the leaf of one entity and move it in the tree right away
+void bvh_update(entity_t *e) {
+    if (bvh_fit_leaf(e)) return;
+    uint32_t leaf = ENTITY_COLD(e)->leaf;
+    if (entity_bvh.nodes[leaf].parent || entity_bvh.root == leaf) bvh_remove(leaf);
+    bvh_insert(leaf);
+}
+
+void bvh_drop(entity_t *e) {
+    entity_cold_t *c = ENTITY_COLD(e);
+    if (!c->leaf) return;
+    bvh_remove(c->leaf);
+    bvh_release(c->leaf);
+    c->leaf = 0;
+    entity_bvh.leaves--;
+}
+
+// grow a node list to hold n nodes
+void bvh_reserve(uint32_t **list, uint32_t *capacity, uint32_t n) {
+    if (n <= *capacity) return;
+    uint32_t grown = (*capacity) ? *capacity : BVH_NODES_MIN;
+    while (grown < n) grown *= 2;
+    *list = (uint32_t*)MemRealloc(*list, grown*sizeof(uint32_t));
+    if (!*list) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for the spatial index!"));
+        exit(1);
+    }
+    *capacity = grown;
+}
+
+// extend lo/hi to hold c, with plain compares as bvh_union
+static inline void bvh_grow(Vector3 *lo, Vector3 *hi, Vector3 c) {
+    if (c.x < lo->x) lo->x = c.x;
+    if (c.y < lo->y) lo->y = c.y;
+    if (c.z < lo->z) lo->z = c.z;
+    if (c.x > hi->x) hi->x = c.x;
+    if (c.y > hi->y) hi->y = c.y;
+    if (c.z > hi->z) hi->z = c.z;
+}
+
+// build a subtree over the leaves of old listed by items, their centers within lo/hi: split at the
+// middle of the widest extent (in halves when the centers are all the same), the bounds of both
+// sides are gathered while partitioning, nodes are laid out in pre-order
+uint32_t bvh_build(const bvh_node_t *old, bvh_item_t *items, uint32_t n, Vector3 lo, Vector3 hi) {
+    bvh_tree_t *b = &entity_bvh;
+    uint32_t a = b->count++;
+    if (n == 1) {
+        b->nodes[a] = old[items[0].node];
+        entity_pool.cold[b->nodes[a].owner].leaf = a;
+        return a;
+    }
+
+    Vector3 d = Vector3Subtract(hi, lo);
+    int axis = (d.x >= d.y && d.x >= d.z) ? 0 : (d.y >= d.z) ? 1 : 2;
+    float mid = ((axis == 0) ? lo.x + hi.x : (axis == 1) ? lo.y + hi.y : lo.z + hi.z)*.5f;
+    Vector3 lo_left = hi, hi_left = lo, lo_right = hi, hi_right = lo;
+    uint32_t k = 0, j = n;
+    while (k < j) {
+        Vector3 c = items[k].center;
+        if (((axis == 0) ? c.x : (axis == 1) ? c.y : c.z) < mid) {
+            bvh_grow(&lo_left, &hi_left, c);
+            k++;
+        } else {
+            bvh_grow(&lo_right, &hi_right, c);
+            bvh_item_t swap = items[k]; items[k] = items[--j]; items[j] = swap;
+        }
+    }
+    if (!k || k == n) {
+        k = n/2;
+        lo_left = lo_right = lo;
+        hi_left = hi_right = hi;
+    }
+
+    uint32_t left = bvh_build(old, items, k, lo_left, hi_left), right = bvh_build(old, items + k, n - k, lo_right, hi_right);
+    bvh_node_t *nodes = b->nodes;
+    nodes[a] = (bvh_node_t){0};
+    nodes[a].left = left;
+    nodes[a].right = right;
+    nodes[left].parent = a;
+    nodes[right].parent = a;
+    bvh_fit(nodes, a);
+    b->area += bvh_area(nodes[a].box);
+    return a;
+}
+
+// rebuild the tree over every leaf into a new node array, which drops the free nodes
+void bvh_rebuild() {
+    bvh_tree_t *b = &entity_bvh;
+    if (b->leaves > b->item_capacity) {
+        b->items = (bvh_item_t*)MemRealloc(b->items, b->leaves*sizeof(bvh_item_t));
+        if (!b->items) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for the spatial index!"));
+            exit(1);
+        }
+        b->item_capacity = b->leaves;
+    }
+    uint32_t n = 0;
+    Vector3 lo = {INFINITY, INFINITY, INFINITY}, hi = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = 1; i < b->count; i++) {
+        bvh_node_t *node = &b->nodes[i];
+        if (!node->owner || entity_pool.cold[node->owner].leaf != i) continue;
+        b->items[n] = (bvh_item_t){{node->sphere.x, node->sphere.y, node->sphere.z}, i};
+        bvh_grow(&lo, &hi, b->items[n++].center);
+    }
+
+    bvh_node_t *old = b->nodes;
+    b->capacity = (2*n > BVH_NODES_MIN) ? 2*n : BVH_NODES_MIN;
+    b->nodes = (bvh_node_t*)MemAlloc(b->capacity*sizeof(bvh_node_t));
+    if (!b->nodes) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory for the spatial index!"));
+        exit(1);
+    }
+    b->count = 1; // node 0 is the null node
+    b->free_head = 0;
+    b->area = 0.f;
+    b->root = (n) ? bvh_build(old, b->items, n, lo, hi) : 0;
+    if (b->root) b->nodes[b->root].parent = 0;
+    if (n > 1) b->area /= fmaxf(bvh_area(b->nodes[b->root].box), 1e-12f);
+    MemFree(old);
+}
+
+// refit every inner node to its children, bottom up (parents come before their children in
+// pre-order), returns the surface area of the inner nodes over the root one
+float bvh_refit_all() {
+    bvh_tree_t *b = &entity_bvh;
+    uint32_t top = 0, n = 0, *stack = bvh_stack();
+    bvh_reserve(&b->inner, &b->inner_capacity, b->count);
+    if (b->root) stack[top++] = b->root;
+    while (top) {
+        uint32_t i = stack[--top];
+        if (!b->nodes[i].left) continue;
+        b->inner[n++] = i;
+        stack[top++] = b->nodes[i].left;
+        stack[top++] = b->nodes[i].right;
+    }
+    float area = 0.f;
+    while (n) {
+        uint32_t i = b->inner[--n];
+        bvh_fit(b->nodes, i);
+        area += bvh_area(b->nodes[i].box);
+    }
+    return (b->root && b->nodes[b->root].left) ? area/fmaxf(bvh_area(b->nodes[b->root].box), 1e-12f) : 0.f;
+}
+
+// take the moved leaves in: a few are reinserted one by one, many are left where they are and the
+// tree refitted once, then new leaves are inserted, or the tree rebuilt when they are many too or
+// when the refits made it too loose (relative area only grows when the leaves move apart unevenly)
+void bvh_settle() {
+    bvh_tree_t *b = &entity_bvh;
+    uint32_t n = b->moved_count, pending = 0;
+    if (!n) return;
+    entity_stats.spatial_moved += n;
+    b->moved_count = 0;
+
+    bool few = (uint64_t)n*BVH_REINSERT <= b->leaves;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t leaf = b->moved[i];
+        if (b->nodes[leaf].parent || b->root == leaf) {
+            if (!few) continue;
+            bvh_remove(leaf);
+        }
+        b->moved[pending++] = leaf;
+    }
+    if (!few && ((uint64_t)pending*BVH_REINSERT > b->leaves || bvh_refit_all() > BVH_DECAY*b->area)) {
+        bvh_rebuild();
+        entity_stats.spatial_rebuilt = 1;
+        return;
+    }
+    for (uint32_t i = 0; i < pending; i++) bvh_insert(b->moved[i]);
+}
+
+// refit the leaves of the transforms resolved by a propagation pass
+void bvh_refit(const tform_task_t *ranges, uint32_t count) {
+    tform_store_t *s = &entity_tforms;
+    bvh_tree_t *b = &entity_bvh;
+    double start = entity_now();
+    for (uint32_t i = 0; i < count; i++)
+        for (uint32_t t = ranges[i].begin; t < ranges[i].end; t++) {
+            entity_t *e = &entity_pool.slots[s->owner[t]];
+            if (!s->owner[t] || ((s->dirty[t] & TFORM_STATIC) && ENTITY_COLD(e)->leaf) || bvh_fit_leaf(e)) continue;
+            bvh_reserve(&b->moved, &b->moved_capacity, b->moved_count + 1);
+            b->moved[b->moved_count++] = ENTITY_COLD(e)->leaf;
+        }
+    bvh_settle();
+    entity_stats.spatial_time += (float)(entity_now() - start);
+}
+
+// traversal stack deep enough for the current tree
+uint32_t *bvh_stack() {
+    bvh_tree_t *b = &entity_bvh;
+    uint32_t need = ((b->root) ? b->nodes[b->root].height : 0) + 2;
+    if (need > b->stack_capacity) {
+        b->stack_capacity = need*2;
+        b->stack = (uint32_t*)MemRealloc(b->stack, b->stack_capacity*sizeof(uint32_t));
+        if (!b->stack) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for the spatial index!"));
+            exit(1);
+        }
+    }
+    return b->stack;
+}
+
+// collect the leaves passing test, inner nodes are skipped as soon as their box fails it
+int bvh_query(bvh_test_t test, const void *arg, entity_id_t *out, int max) {
+    bvh_tree_t *b = &entity_bvh;
+    uint32_t top = 0, *stack = bvh_stack();
+    int n = 0;
+    if (b->root) stack[top++] = b->root;
+    while (top) {
+        const bvh_node_t *node = &b->nodes[stack[--top]];
+        if (!test(node, arg)) continue;
+        if (node->owner) {
+            if (n < max) out[n] = entity_handle(&entity_pool.slots[node->owner]);
+            n++;
+        } else {
+            stack[top++] = node->left;
+            stack[top++] = node->right;
+        }
+    }
+    return n;
+}
+
+void tform_aim_reserve(tform_aim_t *a, uint32_t n) {
+    if (n <= a->capacity) return;
+    uint32_t capacity = (a->capacity) ? a->capacity : 64;
+    while (capacity < n) capacity *= 2;
+    a->dx = (float*)MemRealloc(a->dx, capacity*sizeof(float));
+    a->dy = (float*)MemRealloc(a->dy, capacity*sizeof(float));
+    a->dz = (float*)MemRealloc(a->dz, capacity*sizeof(float));
+    a->qx = (float*)MemRealloc(a->qx, capacity*sizeof(float));
+    a->qy = (float*)MemRealloc(a->qy, capacity*sizeof(float));
+    a->qz = (float*)MemRealloc(a->qz, capacity*sizeof(float));
+    a->qw = (float*)MemRealloc(a->qw, capacity*sizeof(float));
+    a->id = (entity_id_t*)MemRealloc(a->id, capacity*sizeof(entity_id_t));
+    if (!a->dx || !a->dy || !a->dz || !a->qx || !a->qy || !a->qz || !a->qw || !a->id) {
+        TraceLog(LOG_ERROR, TextFormat("unable allocate memory to aim entities!"));
+        exit(1);
+    }
+    a->capacity = capacity;
+}
+
+void tform_aim_write(tform_aim_t *a, uint32_t n) {
+    for (uint32_t k = 0; k < n; k++) entity_set_rotation(a->id[k], (Quaternion){a->qx[k], a->qy[k], a->qz[k], a->qw[k]}, TFORM_WORLD);
+}
+
+#if TFORM_LANES > 1
+// 4 lanes of v where mask is set, of w elsewhere
+static inline __m128 tform_select4(__m128 mask, __m128 v, __m128 w) {
+    return _mm_or_ps(_mm_and_ps(mask, v), _mm_andnot_ps(mask, w));
+}
+
+// move 4 rotations c toward q by rate (q taken in the hemisphere of c), lanes out of mask keep c
+static inline void tform_nlerp4(tform_aim_t *a, uint32_t k, __m128 *q, __m128 mask, float rate) {
+    float *out[4] = {a->qx + k, a->qy + k, a->qz + k, a->qw + k};
+    __m128 c[4], dot = _mm_setzero_ps(), len = _mm_setzero_ps();
+    for (int i = 0; i < 4; i++) {
+        c[i] = _mm_loadu_ps(out[i]);
+        dot = _mm_add_ps(dot, _mm_mul_ps(c[i], q[i]));
+    }
+    __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_set1_ps(-0.f));
+    for (int i = 0; i < 4; i++) {
+        q[i] = _mm_xor_ps(q[i], flip);
+        if (rate < 1.f) q[i] = _mm_add_ps(c[i], _mm_mul_ps(_mm_sub_ps(q[i], c[i]), _mm_set1_ps(rate)));
+        len = _mm_add_ps(len, _mm_mul_ps(q[i], q[i]));
+    }
+    len = _mm_sqrt_ps(len);
+    for (int i = 0; i < 4; i++) _mm_storeu_ps(out[i], tform_select4(mask, _mm_div_ps(q[i], len), c[i]));
+}
+#endif
+
+// scalar version of tform_nlerp4 for one entity
+static inline void tform_nlerp(tform_aim_t *a, uint32_t k, Quaternion q, float rate) {
+    Quaternion c = (Quaternion){a->qx[k], a->qy[k], a->qz[k], a->qw[k]};
+    if (c.x*q.x + c.y*q.y + c.z*q.z + c.w*q.w < 0.f) q = (Quaternion){-q.x, -q.y, -q.z, -q.w};
+    if (rate < 1.f) q = QuaternionLerp(c, q, rate);
+    q = QuaternionNormalize(q);
+    a->qx[k] = q.x; a->qy[k] = q.y; a->qz[k] = q.z; a->qw[k] = q.w;
+}
+
+// rotation turning +z toward each direction without trig: yaw about y then pitch about x, from the
+// half-angle cosines sqrt((1 + cos)/2) of the direction, then the roll about z
+void tform_point_batch(tform_aim_t *a, uint32_t n, Quaternion roll, float rate) {
+    uint32_t k = 0;
+#if TFORM_LANES > 1
+    __m128 one = _mm_set1_ps(1.f), half = _mm_set1_ps(.5f), zero = _mm_setzero_ps(), sign = _mm_set1_ps(-0.f), eps = _mm_set1_ps(1e-12f);
+    __m128 rx = _mm_set1_ps(roll.x), ry = _mm_set1_ps(roll.y), rz = _mm_set1_ps(roll.z), rw = _mm_set1_ps(roll.w);
+    for (; k + 4 <= n; k += 4) {
+        __m128 dx = _mm_loadu_ps(a->dx + k), dy = _mm_loadu_ps(a->dy + k), dz = _mm_loadu_ps(a->dz + k);
+        __m128 h2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), l2 = _mm_add_ps(h2, _mm_mul_ps(dy, dy));
+        __m128 flat = _mm_cmpgt_ps(h2, eps), valid = _mm_cmpgt_ps(l2, eps);
+        __m128 h = _mm_sqrt_ps(h2);
+        __m128 cy = tform_select4(flat, _mm_div_ps(dz, _mm_max_ps(h, eps)), one);
+        __m128 cp = tform_select4(valid, _mm_div_ps(h, _mm_sqrt_ps(_mm_max_ps(l2, eps))), one);
+        __m128 cyh = _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(one, cy), half), zero));
+        __m128 syh = _mm_or_ps(_mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(one, cy), half), zero)), _mm_and_ps(dx, sign));
+        __m128 cph = _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(one, cp), half), zero));
+        __m128 px = _mm_xor_ps(_mm_or_ps(_mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(one, cp), half), zero)), _mm_and_ps(dy, sign)), sign);
+        __m128 x = _mm_mul_ps(cyh, px), y = _mm_mul_ps(cph, syh), z = _mm_xor_ps(_mm_mul_ps(syh, px), sign), w = _mm_mul_ps(cyh, cph);
+        __m128 q[4] = {
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(w, rx), _mm_mul_ps(x, rw)), _mm_sub_ps(_mm_mul_ps(y, rz), _mm_mul_ps(z, ry))),
+            _mm_add_ps(_mm_sub_ps(_mm_mul_ps(w, ry), _mm_mul_ps(x, rz)), _mm_add_ps(_mm_mul_ps(y, rw), _mm_mul_ps(z, rx))),
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(w, rz), _mm_mul_ps(x, ry)), _mm_sub_ps(_mm_mul_ps(z, rw), _mm_mul_ps(y, rx))),
+            _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(w, rw), _mm_mul_ps(x, rx)), _mm_add_ps(_mm_mul_ps(y, ry), _mm_mul_ps(z, rz)))
+        };
+        tform_nlerp4(a, k, q, valid, rate);
+    }
+#endif
+    for (; k < n; k++) {
+        float dx = a->dx[k], dy = a->dy[k], dz = a->dz[k];
+        float h2 = dx*dx + dz*dz, l2 = h2 + dy*dy;
+        if (l2 <= 1e-12f) continue;
+        float cy = (h2 > 1e-12f) ? dz/sqrtf(h2) : 1.f, cp = sqrtf(h2/l2);
+        float cyh = sqrtf(fmaxf((1.f + cy)*.5f, 0.f)), syh = copysignf(sqrtf(fmaxf((1.f - cy)*.5f, 0.f)), dx);
+        float cph = sqrtf(fmaxf((1.f + cp)*.5f, 0.f)), px = -copysignf(sqrtf(fmaxf((1.f - cp)*.5f, 0.f)), dy);
+        Quaternion q = (Quaternion){cyh*px, cph*syh, -syh*px, cyh*cph};
+        tform_nlerp(a, k, QuaternionMultiply(q, roll), rate);
+    }
+}
+
+// shortest arc from the current world axis of each entity to its direction, (axis x dir, 1 + axis.dir)
+// normalized, around any perpendicular axis when they are opposite
+void tform_align_batch(tform_aim_t *a, uint32_t n, int axis, float rate) {
+    uint32_t k = 0;
+#if TFORM_LANES > 1
+    __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f), zero = _mm_setzero_ps(), sign = _mm_set1_ps(-0.f), eps = _mm_set1_ps(1e-12f);
+    for (; k + 4 <= n; k += 4) {
+        __m128 x = _mm_loadu_ps(a->qx + k), y = _mm_loadu_ps(a->qy + k), z = _mm_loadu_ps(a->qz + k), w = _mm_loadu_ps(a->qw + k);
+        __m128 ax, ay, az;
+        if (axis == 1) {
+            ax = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+            ay = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, y), _mm_mul_ps(w, z)));
+            az = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(x, z), _mm_mul_ps(w, y)));
+        } else if (axis == 2) {
+            ax = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(x, y), _mm_mul_ps(w, z)));
+            ay = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z))));
+            az = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, z), _mm_mul_ps(w, x)));
+        } else {
+            ax = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, z), _mm_mul_ps(w, y)));
+            ay = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(y, z), _mm_mul_ps(w, x)));
+            az = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+        }
+        __m128 dx = _mm_loadu_ps(a->dx + k), dy = _mm_loadu_ps(a->dy + k), dz = _mm_loadu_ps(a->dz + k);
+        __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 valid = _mm_cmpgt_ps(l2, eps), l = _mm_sqrt_ps(_mm_max_ps(l2, eps));
+        dx = _mm_div_ps(dx, l); dy = _mm_div_ps(dy, l); dz = _mm_div_ps(dz, l);
+
+        // arc, or a half turn around a perpendicular of the axis: axis x (1,0,0), or axis x (0,1,0) if nearly x
+        __m128 cw = _mm_add_ps(one, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, dx), _mm_mul_ps(ay, dy)), _mm_mul_ps(az, dz)));
+        __m128 cx = _mm_sub_ps(_mm_mul_ps(ay, dz), _mm_mul_ps(az, dy));
+        __m128 cy = _mm_sub_ps(_mm_mul_ps(az, dx), _mm_mul_ps(ax, dz));
+        __m128 cz = _mm_sub_ps(_mm_mul_ps(ax, dy), _mm_mul_ps(ay, dx));
+        __m128 opposite = _mm_cmplt_ps(cw, _mm_set1_ps(1e-6f)), alongx = _mm_cmpgt_ps(_mm_andnot_ps(sign, ax), _mm_set1_ps(.9f));
+        cx = tform_select4(opposite, tform_select4(alongx, _mm_xor_ps(az, sign), zero), cx);
+        cy = tform_select4(opposite, tform_select4(alongx, zero, az), cy);
+        cz = tform_select4(opposite, tform_select4(alongx, ax, _mm_xor_ps(ay, sign)), cz);
+        cw = tform_select4(opposite, zero, cw);
+        __m128 len = _mm_sqrt_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_add_ps(_mm_mul_ps(cz, cz), _mm_mul_ps(cw, cw))), eps));
+        cx = _mm_div_ps(cx, len); cy = _mm_div_ps(cy, len); cz = _mm_div_ps(cz, len); cw = _mm_div_ps(cw, len);
+
+        // arc * current rotation
+        __m128 q[4] = {
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(cw, x), _mm_mul_ps(cx, w)), _mm_sub_ps(_mm_mul_ps(cy, z), _mm_mul_ps(cz, y))),
+            _mm_add_ps(_mm_sub_ps(_mm_mul_ps(cw, y), _mm_mul_ps(cx, z)), _mm_add_ps(_mm_mul_ps(cy, w), _mm_mul_ps(cz, x))),
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(cw, z), _mm_mul_ps(cx, y)), _mm_sub_ps(_mm_mul_ps(cz, w), _mm_mul_ps(cy, x))),
+            _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(cw, w), _mm_mul_ps(cx, x)), _mm_add_ps(_mm_mul_ps(cy, y), _mm_mul_ps(cz, z)))
+        };
+        tform_nlerp4(a, k, q, valid, rate);
+    }
+#endif
+    for (; k < n; k++) {
+        Quaternion c = (Quaternion){a->qx[k], a->qy[k], a->qz[k], a->qw[k]};
+        Vector3 d = (Vector3){a->dx[k], a->dy[k], a->dz[k]};
+        float l2 = Vector3DotProduct(d, d);
+        if (l2 <= 1e-12f) continue;
+        d = Vector3Scale(d, 1.f/sqrtf(l2));
+        Vector3 v = Vector3RotateByQuaternion((axis == 1) ? (Vector3){1.f, 0.f, 0.f} : (axis == 2) ? (Vector3){0.f, 1.f, 0.f} : (Vector3){0.f, 0.f, 1.f}, c);
+        Vector3 u = Vector3CrossProduct(v, d);
+        float w = 1.f + Vector3DotProduct(v, d);
+        if (w < 1e-6f) {
+            u = (fabsf(v.x) > .9f) ? (Vector3){-v.z, 0.f, v.x} : (Vector3){0.f, v.z, -v.y};
+            w = 0.f;
+        }
+        tform_nlerp(a, k, QuaternionMultiply(QuaternionNormalize((Quaternion){u.x, u.y, u.z, w}), c), rate);
+    }
+}
+
+// true if the box is at least partly in front of all the planes
+bool tform_box_visible(BoundingBox box, const Vector4 *planes) {
+    Vector3 c = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+    Vector3 e = Vector3Subtract(box.max, c);
+    for (int p = 0; p < 6; p++) {
+        float r = fabsf(planes[p].x)*e.x + fabsf(planes[p].y)*e.y + fabsf(planes[p].z)*e.z;
+        if (planes[p].x*c.x + planes[p].y*c.y + planes[p].z*c.z + planes[p].w < -r) return false;
+    }
+    return true;
+}
+
+// append t to the scratch path at n, returns the new length
+uint32_t tform_path_push(uint32_t n, uint32_t t) {
+    tform_dirty_set_t *d = &entity_dirty;
+    if (n == d->path_capacity) {
+        d->path_capacity = (d->path_capacity) ? d->path_capacity*2 : 64;
+        d->path = (uint32_t*)MemRealloc(d->path, d->path_capacity*sizeof(uint32_t));
+        if (!d->path) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for dirty entities!"));
+            exit(1);
+        }
+    }
+    d->path[n] = t;
+    return n + 1;
+}
+
+// entity slot p is about to lose a child, its subtree box (and its ancestors') is rebuilt by the next pass
+void tform_reshape(uint32_t p) {
+    tform_dirty_set_t *d = &entity_dirty;
+    if (!p) return;
+    if (d->reshaped_count == d->reshaped_capacity) {
+        d->reshaped_capacity = (d->reshaped_capacity) ? d->reshaped_capacity*2 : 64;
+        d->reshaped = (uint32_t*)MemRealloc(d->reshaped, d->reshaped_capacity*sizeof(uint32_t));
+        if (!d->reshaped) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory for dirty entities!"));
+            exit(1);
+        }
+    }
+    d->reshaped[d->reshaped_count++] = entity_handle(&entity_pool.slots[p]);
+}
+
+static inline void tform_box_merge(BoundingBox *dst, const BoundingBox *src) {
+    if (src->min.x > src->max.x) return; // empty
+    dst->min.x = (src->min.x < dst->min.x) ? src->min.x : dst->min.x;
+    dst->min.y = (src->min.y < dst->min.y) ? src->min.y : dst->min.y;
+    dst->min.z = (src->min.z < dst->min.z) ? src->min.z : dst->min.z;
+    dst->max.x = (src->max.x > dst->max.x) ? src->max.x : dst->max.x;
+    dst->max.y = (src->max.y > dst->max.y) ? src->max.y : dst->max.y;
+    dst->max.z = (src->max.z > dst->max.z) ? src->max.z : dst->max.z;
+}
+
+static int tform_desc_compare(const void *a, const void *b) {
+    uint32_t ta = *(const uint32_t*)a, tb = *(const uint32_t*)b;
+    return (ta < tb) - (ta > tb);
+}
+
+// rebuild the subtree boxes of the resolved ranges bottom-up (children follow their parent in the store),
+// then the boxes of their ancestors and of the reshaped entities, each once, deepest first
+void tform_update_bounds(const tform_task_t *ranges, uint32_t count) {
+    tform_store_t *s = &entity_tforms;
+    tform_dirty_set_t *d = &entity_dirty;
+    for (uint32_t i = 0; i < count; i++)
+        for (uint32_t t = ranges[i].end; t-- > ranges[i].begin;) tform_tree_box(s, t);
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count + d->reshaped_count; i++) {
+        uint32_t a;
+        if (i < count) a = s->parent[ranges[i].begin];
+        else if (entity_is_valid(d->reshaped[i - count])) a = entity_pool.slots[d->reshaped[i - count] & ENTITY_INDEX_MASK].tf;
+        else continue;
+        for (; a && !(s->dirty[a] & TFORM_DIRTY_BOUNDS); a = s->parent[a]) {
+            s->dirty[a] |= TFORM_DIRTY_BOUNDS;
+            n = tform_path_push(n, a);
+        }
+    }
+    d->reshaped_count = 0;
+    if (n > 1) qsort(d->path, n, sizeof(uint32_t), tform_desc_compare);
+
+    for (uint32_t k = 0; k < n; k++) {
+        tform_tree_box(s, d->path[k]);
+        s->dirty[d->path[k]] &=~TFORM_DIRTY_BOUNDS;
+    }
+}
+
+// subtree box of t from its own box and the ones of its children, which are up to date
+void tform_tree_box(tform_store_t *s, uint32_t t) {
+    BoundingBox box = tform_own_box(s, t);
+    uint8_t unbounded = (s->bounds[t].w <= 0.f) ? TFORM_TREE_UNBOUNDED : 0;
+    for (uint32_t c = t + 1; c < t + s->size[t]; c += s->size[c]) {
+        tform_box_merge(&box, &s->tree_box[c]);
+        unbounded |= s->dirty[c] & TFORM_TREE_UNBOUNDED;
+    }
+    s->tree_box[t] = box;
+    s->dirty[t] = (s->dirty[t] & ~TFORM_TREE_UNBOUNDED) | unbounded;
+}
+
+// lerp positions and scales, nlerp rotations (keys share a hemisphere, see entity_clip_set_key)
+// between the two keys around time, 4 tracks per step when SIMD is enabled
+void clip_sample(entity_clip_t *clip, float time) {
+    int keys = clip->keys, tracks = clip->tracks, k = 0;
+    size_t n = (size_t)tracks*keys;
+    float alpha = 0.f;
+    while (k + 1 < keys && time >= clip->times[k + 1]) k++;
+    if (k + 1 < keys && time > clip->times[k]) alpha = (time - clip->times[k])/(clip->times[k + 1] - clip->times[k]);
+    int next = (k + 1 < keys) ? k + 1 : k;
+
+    const float *a[CLIP_CHANNELS], *b[CLIP_CHANNELS];
+    float *out[CLIP_CHANNELS];
+    for (int ch = 0; ch < CLIP_CHANNELS; ch++) {
+        a[ch] = clip->channels + ch*n + (size_t)k*tracks;
+        b[ch] = clip->channels + ch*n + (size_t)next*tracks;
+        out[ch] = clip->sample + (size_t)ch*tracks;
+    }
+
+    int i = 0;
+#if TFORM_LANES > 1
+    __m128 t = _mm_set1_ps(alpha), u = _mm_set1_ps(1.f - alpha);
+    for (; i + 4 <= tracks; i += 4) {
+        for (int ch = CLIP_PX; ch <= CLIP_PZ; ch++)
+            _mm_storeu_ps(out[ch] + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a[ch] + i), u), _mm_mul_ps(_mm_loadu_ps(b[ch] + i), t)));
+        for (int ch = CLIP_SX; ch <= CLIP_SZ; ch++)
+            _mm_storeu_ps(out[ch] + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a[ch] + i), u), _mm_mul_ps(_mm_loadu_ps(b[ch] + i), t)));
+        __m128 q[4], len = _mm_setzero_ps();
+        for (int c = 0; c < 4; c++) {
+            q[c] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a[CLIP_RX + c] + i), u), _mm_mul_ps(_mm_loadu_ps(b[CLIP_RX + c] + i), t));
+            len = _mm_add_ps(len, _mm_mul_ps(q[c], q[c]));
+        }
+        len = _mm_sqrt_ps(len);
+        for (int c = 0; c < 4; c++) _mm_storeu_ps(out[CLIP_RX + c] + i, _mm_div_ps(q[c], len));
+    }
+#endif
+    for (; i < tracks; i++) {
+        for (int ch = 0; ch < CLIP_CHANNELS; ch++) out[ch][i] = a[ch][i]*(1.f - alpha) + b[ch][i]*alpha;
+        float len = sqrtf(out[CLIP_RX][i]*out[CLIP_RX][i] + out[CLIP_RY][i]*out[CLIP_RY][i] + out[CLIP_RZ][i]*out[CLIP_RZ][i] + out[CLIP_RW][i]*out[CLIP_RW][i]);
+        for (int ch = CLIP_RX; ch <= CLIP_RW; ch++) out[ch][i] /= len;
+    }
+}
+
+static int clip_order_compare(const void *a, const void *b) {
+    uint64_t oa = *(const uint64_t*)a, ob = *(const uint64_t*)b;
+    return (oa > ob) - (oa < ob);
+}
+
+// write the last sample of the bound tracks in store order, parents before children: a track below an
+// entity already flagged is covered by that entity's subtree range and is not queued again
+void clip_write(entity_clip_t *clip) {
+    tform_store_t *s = &entity_tforms;
+    int tracks = clip->tracks;
+    const float *v = clip->sample;
+
+    // refresh the store indices, sort again only when the order was broken by a structural change
+    bool sorted = true;
+    uint64_t last = 0;
+    for (int k = 0; k < tracks; k++) {
+        uint32_t i = (uint32_t)clip->order[k], t = 0;
+        if (entity_is_valid(clip->targets[i])) t = entity_pool.slots[clip->targets[i] & ENTITY_INDEX_MASK].tf;
+        clip->order[k] = ((uint64_t)t << 32) | i;
+        if (clip->order[k] < last) sorted = false;
+        last = clip->order[k];
+    }
+    if (!sorted) qsort(clip->order, tracks, sizeof(uint64_t), clip_order_compare);
+
+    for (int k = 0; k < tracks; k++) {
+        uint32_t t = (uint32_t)(clip->order[k] >> 32), i = (uint32_t)clip->order[k];
+        if (!t) continue;
+        entity_tick_rec_t *r = (entity_ticks.count) ? entity_tick_rec(clip->targets[i] & ENTITY_INDEX_MASK) : NULL;
+        if ((r && !r->due) || (s->dirty[t] & TFORM_STATIC)) continue; // static targets keep their pose, without the warning of the setters
+        s->pos[t] = (Vector3){v[CLIP_PX*tracks + i], v[CLIP_PY*tracks + i], v[CLIP_PZ*tracks + i]};
+        s->rot[t] = (Quaternion){v[CLIP_RX*tracks + i], v[CLIP_RY*tracks + i], v[CLIP_RZ*tracks + i], v[CLIP_RW*tracks + i]};
+        s->scale[t] = (Vector3){v[CLIP_SX*tracks + i], v[CLIP_SY*tracks + i], v[CLIP_SZ*tracks + i]};
+        if (s->parent[t] && (s->dirty[s->parent[t]] & TFORM_DIRTY_WORLD)) s->dirty[t] |= TFORM_DIRTY_WORLD;
+        else entity_invalidate_tform(&entity_pool.slots[clip->targets[i] & ENTITY_INDEX_MASK]);
+    }
+}
+
+// tick record of the entity at slot i, NULL if it ticks every frame
+entity_tick_rec_t *entity_tick_rec(uint32_t i) {
+    entity_ticks_t *k = &entity_ticks;
+    if (i >= k->slots || !k->at[i]) return NULL;
+    entity_tick_rec_t *r = &k->items[k->at[i] - 1];
+    return (r->id == entity_handle(&entity_pool.slots[i])) ? r : NULL;
+}
+
+// shift the last record to the previous one and record the resolved world transform of the entity
+void entity_tick_record(entity_tick_rec_t *r) {
+    uint32_t t = entity_pool.slots[r->id & ENTITY_INDEX_MASK].tf;
+    Matrix m = entity_tforms.world[t];
+    bool first = !r->period;
+    r->pos[0] = r->pos[1];
+    r->rot[0] = r->rot[1];
+    r->scale[0] = r->scale[1];
+    r->pos[1] = (Vector3){m.m12, m.m13, m.m14};
+    r->rot[1] = entity_tforms.world_rot[t];
+    r->scale[1] = entity_tforms.world_scale[t];
+    if (first) {
+        r->pos[0] = r->pos[1];
+        r->rot[0] = r->rot[1];
+        r->scale[0] = r->scale[1];
+    }
+    uint32_t frames = entity_ticks.frame - r->frame;
+    r->period = (first) ? 1 : (frames > 255) ? 255 : (uint8_t)frames;
+    r->frame = entity_ticks.frame;
+}
@@ -0,0 +1,174 @@
+/*******************************************************************************************
+*
+*   entity: simple entity system, hierarchy and transforms of raylib entities
+*
+*   This example has been created using raylib 3.7 (www.raylib.com)
+*   raylib is licensed under an unmodified zlib/libpng license (View raylib.h for details)
+*
+*   Copyright (c) 2021 Christophe TES (@seyhajin)
+*
+********************************************************************************************/
+
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <stdint.h>
+
+#include "raylib.h"
+#include "raymath.h"
+
+//--------------------------------------
+// types/structures declaration
+//--------------------------------------
+
+typedef enum tform_space_e {
+    TFORM_LOCAL = 0,
+    TFORM_WORLD = 1,
+} tform_space_t;
+
+// entity handle: slot generation (high bits) | slot index (low bits)
+// a handle becomes stale as soon as its slot is freed, slot 0 is never used so 0 is the null handle
+typedef uint32_t entity_id_t;
+
+#define ENTITY_NONE         0
+
+// deferred command buffer, one per recording thread
+typedef struct entity_cmds_s entity_cmds_t;
+
+// read-only world transforms published for other threads
+typedef struct entity_snapshot_s entity_snapshot_t;
+
+// keyframe clip: one track per animated entity, position/rotation/scale keys at times shared by all tracks
+typedef struct entity_clip_s entity_clip_t;
+
+// update rate of an entity, staggered across frames (entity_tick_begin/entity_tick_due)
+typedef enum entity_tick_e {
+    ENTITY_TICK_ALWAYS = 0,     // every frame
+    ENTITY_TICK_HALF,           // every 2nd frame
+    ENTITY_TICK_QUARTER,        // every 4th frame
+    ENTITY_TICK_DISTANCE,       // every frame, 2nd or 4th by distance to the camera (entity_set_tick_distances)
+    ENTITY_TICK_GROUPS
+} entity_tick_t;
+
+typedef struct entity_stats_s {
+    uint32_t dirty_roots;       // subtrees resolved by the last entity_update_world_all
+    uint32_t tforms_touched;    // world matrices recomputed by the last entity_update_world_all
+    uint32_t cull_visible;      // entities kept by the last entity_cull
+    uint32_t cull_culled;       // entities rejected by the last entity_cull
+    uint32_t cull_branches;     // subtrees rejected in one test by the last entity_cull
+    uint32_t spatial_moved;     // leaves new or out of their fattened box in the last entity_update_world_all
+    uint32_t spatial_rebuilt;   // 1 if the last entity_update_world_all rebuilt the spatial index
+    float spatial_time;         // wall seconds spent on the spatial index by the last entity_update_world_all
+} entity_stats_t;
+
+//--------------------------------------
+// public entity functions declaration
+//--------------------------------------
+entity_id_t create_entity();
+entity_id_t copy_entity(entity_id_t e);
+entity_id_t instantiate_subtree(entity_id_t src, entity_id_t parent);
+void free_entity(entity_id_t e);
+bool entity_is_valid(entity_id_t e);
+
+void entity_set_parent(entity_id_t e, entity_id_t p);
+void entity_set_name(entity_id_t e, const char *name);
+void entity_set_visible(entity_id_t e, bool visible);
+void entity_set_enabled(entity_id_t e, bool enabled);
+void entity_set_static(entity_id_t e, bool enable);
+bool entity_is_static(entity_id_t e);
+entity_id_t entity_get_parent(entity_id_t e);
+const char *entity_get_name(entity_id_t e);
+entity_id_t entity_get_children(entity_id_t e);
+entity_id_t entity_get_successor(entity_id_t e);
+entity_id_t entity_find(entity_id_t from, const char *path);
+
+// entity transform functions
+void entity_set_position(entity_id_t e, Vector3 pos, tform_space_t global);
+void entity_set_scale(entity_id_t e, Vector3 scale, tform_space_t global);
+void entity_set_rotation(entity_id_t e, Quaternion rot, tform_space_t global);
+Vector3 entity_get_position(entity_id_t e, tform_space_t global);
+Vector3 entity_get_scale(entity_id_t e, tform_space_t global);
+Quaternion entity_get_rotation(entity_id_t e, tform_space_t global);
+void entity_set_tform(entity_id_t e, Matrix mat, tform_space_t global);
+Matrix entity_get_tform(entity_id_t e, tform_space_t global);
+void entity_set_bounds(entity_id_t e, Vector3 center, float radius);
+void entity_get_bounds(entity_id_t e, Vector3 *center, float *radius, tform_space_t global);
+BoundingBox entity_get_subtree_bounds(entity_id_t e);
+void entity_update_world_all();
+void entity_set_threads(int count);
+entity_stats_t entity_get_stats();
+
+void move_entity(entity_id_t e, float x, float y, float z);
+void turn_entity(entity_id_t e, float p, float y, float r, tform_space_t global);
+void translate_entity(entity_id_t e, float x, float y, float z, tform_space_t global);
+void position_entity(entity_id_t e, float x, float y, float z, tform_space_t global);
+void scale_entity(entity_id_t e, float x, float y, float z, tform_space_t global);
+void rotate_entity(entity_id_t e, float p, float y, float r, tform_space_t global);
+void point_entity(entity_id_t e, entity_id_t t, float roll);
+void align_entity(entity_id_t e, float nx, float ny, float nz, int axis, float rate);
+void point_entities(const entity_id_t *e, const entity_id_t *t, int count, float roll, float rate);
+void align_entities(const entity_id_t *e, const Vector3 *dir, int count, int axis, float rate);
+
+int entity_enum_visible(entity_id_t e, entity_id_t *out, int max);
+int entity_enum_enabled(entity_id_t e, entity_id_t *out, int max);
+int entity_cull(Matrix viewproj, entity_id_t *out, int max);
+
+// spatial index
+void entity_set_spatial(bool enable);
+int entity_query_radius(Vector3 center, float radius, entity_id_t *out, int max);
+int entity_query_box(BoundingBox box, entity_id_t *out, int max);
+int entity_query_frustum(Matrix viewproj, entity_id_t *out, int max);
+entity_id_t entity_pick(Ray ray, float *distance);
+
+// deferred commands: any thread records into its own buffer, entity_cmds_apply replays the buffers in
+// one deterministic batch on the main thread; entity_cmd_create returns a pending handle, only usable
+// in commands of the same buffer until entity_cmds_resolve maps it after the apply
+entity_cmds_t *entity_cmds_create();
+void entity_cmds_destroy(entity_cmds_t *c);
+entity_id_t entity_cmd_create(entity_cmds_t *c);
+void entity_cmd_free(entity_cmds_t *c, entity_id_t e);
+void entity_cmd_set_parent(entity_cmds_t *c, entity_id_t e, entity_id_t p);
+void entity_cmd_position(entity_cmds_t *c, entity_id_t e, float x, float y, float z, tform_space_t global);
+void entity_cmd_rotate(entity_cmds_t *c, entity_id_t e, float p, float y, float r, tform_space_t global);
+void entity_cmd_turn(entity_cmds_t *c, entity_id_t e, float p, float y, float r, tform_space_t global);
+void entity_cmd_scale(entity_cmds_t *c, entity_id_t e, float x, float y, float z, tform_space_t global);
+void entity_cmd_move(entity_cmds_t *c, entity_id_t e, float x, float y, float z);
+void entity_cmds_apply(entity_cmds_t **bufs, int count);
+entity_id_t entity_cmds_resolve(const entity_cmds_t *c, entity_id_t e);
+
+// transform snapshots: entity_publish (main thread, once per frame) copies the resolved world matrices
+// into a read-only snapshot, other threads read the latest one lock-free between acquire and release
+bool entity_publish();
+const entity_snapshot_t *entity_snapshot_acquire();
+void entity_snapshot_release(const entity_snapshot_t *snap);
+bool entity_snapshot_tform(const entity_snapshot_t *snap, entity_id_t e, Matrix *mat);
+uint64_t entity_snapshot_frame(const entity_snapshot_t *snap);
+
+// animation: clips keep their keys as structures of arrays, entity_animate samples all tracks of the given
+// clips (lerp/nlerp across tracks with SIMD) and writes the local transforms of the bound entities in one batch
+entity_clip_t *entity_clip_create(int tracks, int keys);
+void entity_clip_destroy(entity_clip_t *clip);
+void entity_clip_bind(entity_clip_t *clip, int track, entity_id_t e);
+void entity_clip_set_time(entity_clip_t *clip, int key, float time);
+void entity_clip_set_key(entity_clip_t *clip, int track, int key, Vector3 pos, Quaternion rot, Vector3 scale);
+float entity_clip_duration(const entity_clip_t *clip);
+void entity_animate(entity_clip_t **clips, const float *times, int count);
+
+// tick groups: entity_tick_begin decides which entities update this frame (transform setters, point/align
+// and entity_animate skip the others), entity_tick_end records their world transforms, entity_get_render_tform
+// extrapolates them over the skipped frames
+void entity_set_tick(entity_id_t e, entity_tick_t group);
+entity_tick_t entity_get_tick(entity_id_t e);
+void entity_set_tick_distances(float half, float quarter);
+uint32_t entity_tick_begin(Vector3 camera);
+bool entity_tick_due(entity_id_t e);
+void entity_tick_end();
+Matrix entity_get_render_tform(entity_id_t e);
+
+// scene files: a versioned binary image of a flattened hierarchy (local transforms, bounds, flags and
+// names), entity_load_scene maps it and adopts it in one block instead of building it entity by entity
+bool entity_save_scene(const char *path, entity_id_t root);
+entity_id_t entity_load_scene(const char *path, entity_id_t parent);
+entity_id_t entity_adopt_scene(const void *data, uint32_t size, entity_id_t parent);
+
+#endif // ENTITY_H
@@ -0,0 +1,381 @@
+/*******************************************************************************************
+*
+*   raylib: quadtree (adapted for HTML5 platform)
+*
+*   This example is prepared to compile for PLATFORM_WEB, PLATFORM_DESKTOP and PLATFORM_RPI
+*   As you will notice, code structure is slightly diferent to the other examples...
+*   To compile it for PLATFORM_WEB just uncomment #define PLATFORM_WEB at beginning
+*
+*   This example has been created using raylib 3.7 (www.raylib.com)
+*   raylib is licensed under an unmodified zlib/libpng license (View raylib.h for details)
+*
+*   Copyright (c) 2015 Ramon Santamaria (@raysan5)
+*   Copyright (c) 2021 Christophe TES (@seyhajin)
+*
+********************************************************************************************/
+
+#include <stdlib.h>
+
+#include "entity.h"
+#include "rlgl.h"
+
+//#define PLATFORM_WEB
+
+#if defined(PLATFORM_WEB)
+    #include <emscripten/emscripten.h>
+#endif
+
+//--------------------------------------
+// Global Variables Definition
+//--------------------------------------
+static int screen_width = 1024;
+static int screen_height = 768;
+
+static Camera camera = {0};
+static entity_id_t center = ENTITY_NONE;
+static entity_id_t child1 = ENTITY_NONE;
+static entity_id_t child2 = ENTITY_NONE;
+static entity_id_t child3 = ENTITY_NONE;
+
+static Model cube;
+static Model sphere;
+
+static float dt = 0.f;
+
+// model and tint of each drawn entity, only the ones surviving entity_cull are drawn
+typedef struct draw_entity_s {
+    entity_id_t id;
+    Model *model;
+    Color tint;
+} draw_entity_t;
+
+#define RING_ENTITIES       32      // cubes around the center, drawn with one instanced call
+#define MAX_DRAW_ENTITIES   (4 + RING_ENTITIES)
+#define CULL_DISTANCE_NEAR  0.01    // same clip planes as rlgl
+#define CULL_DISTANCE_FAR   1000.0
+
+static draw_entity_t draw_entities[MAX_DRAW_ENTITIES] = {0};
+static entity_id_t draw_visible[MAX_DRAW_ENTITIES] = {0};
+
+// entity models queued by DrawEntityModel, grouped by model until FlushEntityModels
+typedef struct draw_batch_s {
+    Model model;
+    Matrix *transforms;
+    Color *tints;       // one per instance, along the transforms
+    int count, capacity;
+} draw_batch_t;
+
+#define MAX_DRAW_BATCHES 64
+
+static draw_batch_t draw_batches[MAX_DRAW_BATCHES] = {0};
+static int draw_batch_count = 0;
+static Shader draw_instanced = {0};     // draws one mesh per instance transform and tint
+static int draw_instanced_tint = -1;    // location of the instance tint attribute
+static int draw_calls = 0;              // submitted since the frame began, reset by UpdateDrawFrame
+static int draw_instances = 0;
+
+#if defined(PLATFORM_WEB)
+static const char *draw_instanced_vs =
+    "#version 100\n"
+    "attribute vec3 vertexPosition;\n"
+    "attribute vec2 vertexTexCoord;\n"
+    "attribute mat4 instanceTransform;\n"
+    "attribute vec4 instanceTint;\n"
+    "uniform mat4 mvp;\n"
+    "varying vec2 fragTexCoord;\n"
+    "varying vec4 fragTint;\n"
+    "void main() {\n"
+    "    fragTexCoord = vertexTexCoord;\n"
+    "    fragTint = instanceTint;\n"
+    "    gl_Position = mvp*instanceTransform*vec4(vertexPosition, 1.0);\n"
+    "}\n";
+static const char *draw_instanced_fs =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "varying vec2 fragTexCoord;\n"
+    "varying vec4 fragTint;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "void main() {\n"
+    "    gl_FragColor = texture2D(texture0, fragTexCoord)*colDiffuse*fragTint;\n"
+    "}\n";
+#else
+static const char *draw_instanced_vs =
+    "#version 330\n"
+    "in vec3 vertexPosition;\n"
+    "in vec2 vertexTexCoord;\n"
+    "in mat4 instanceTransform;\n"
+    "in vec4 instanceTint;\n"
+    "uniform mat4 mvp;\n"
+    "out vec2 fragTexCoord;\n"
+    "out vec4 fragTint;\n"
+    "void main() {\n"
+    "    fragTexCoord = vertexTexCoord;\n"
+    "    fragTint = instanceTint;\n"
+    "    gl_Position = mvp*instanceTransform*vec4(vertexPosition, 1.0);\n"
+    "}\n";
+static const char *draw_instanced_fs =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragTint;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main() {\n"
+    "    finalColor = texture(texture0, fragTexCoord)*colDiffuse*fragTint;\n"
+    "}\n";
+#endif
+
+//--------------------------------------
+// Module Functions Declaration
+//--------------------------------------
+void UpdateDrawFrame(void);     // Update and Draw one frame
+void InitEntityRenderer(void);
+void UnloadEntityRenderer(void);
+void DrawEntityModel(entity_id_t e, Model model, Color tint);
+void FlushEntityModels(void);
+void DrawEntityOrbit(entity_id_t e, Color tint);
+Color TintColor(Color color, Color tint);
+
+//----------------------------------------------------------------------------------
+// Main Enry Point
+//----------------------------------------------------------------------------------
+int main()
+{
+    //--------------------------------------
+    // Initialization
+    //--------------------------------------
+    InitWindow(screen_width, screen_height, "raylib: entity system");
+
+    // camera 3d
+    camera.position = (Vector3){0.f, 10.f, 15.f};
+    camera.target = (Vector3){0.f, 0.f, 0.f};
+    camera.up = (Vector3){0.f, 1.f, 0.f};
+    camera.fovy = 45.f;
+    camera.projection = CAMERA_PERSPECTIVE;
+
+    // entities
+    center = create_entity();
+    child1 = create_entity();
+    child2 = create_entity();
+    child3 = create_entity();
+
+    entity_set_parent(child1, center);
+    position_entity(child1, 0.f, 0.f, -5.f, TFORM_LOCAL);
+
+    entity_set_parent(child2, child1);
+    scale_entity(child2, 0.5f, 0.5f, 0.5f, TFORM_LOCAL);
+    position_entity(child2, 3.f, 0.f, 0.f, TFORM_LOCAL);
+
+    entity_set_parent(child3, child2);
+    scale_entity(child3, 0.25f, 0.25f, 0.25f, TFORM_LOCAL);
+    position_entity(child3, 0.f, 0.f, -2.f, TFORM_LOCAL);
+
+    // ring of small cubes, turning with the center
+    for (int i = 0; i < RING_ENTITIES; i++) {
+        entity_id_t e = create_entity();
+        entity_set_parent(e, center);
+        scale_entity(e, 0.3f, 0.3f, 0.3f, TFORM_LOCAL);
+        position_entity(e, 8.f*cosf(2*PI*i/RING_ENTITIES), 0.f, 8.f*sinf(2*PI*i/RING_ENTITIES), TFORM_LOCAL);
+        entity_set_bounds(e, Vector3Zero(), 0.866f);
+        draw_entities[4 + i] = (draw_entity_t){e, &cube, ColorFromHSV(360.f*i/RING_ENTITIES, 0.8f, 0.9f)};
+    }
+
+    // models
+    cube = LoadModelFromMesh(GenMeshCube(1.0f, 1.0f, 1.0f));
+    sphere = LoadModelFromMesh(GenMeshSphere(1.0f, 12, 8));
+    InitEntityRenderer();
+
+    // bounds (cube corners and unit sphere)
+    entity_set_bounds(center, Vector3Zero(), 0.866f);
+    entity_set_bounds(child1, Vector3Zero(), 0.866f);
+    entity_set_bounds(child2, Vector3Zero(), 1.f);
+    entity_set_bounds(child3, Vector3Zero(), 1.f);
+
+    draw_entities[0] = (draw_entity_t){center, &cube, RED};
+    draw_entities[1] = (draw_entity_t){child1, &cube, GREEN};
+    draw_entities[2] = (draw_entity_t){child2, &sphere, BLUE};
+    draw_entities[3] = (draw_entity_t){child3, &sphere, MAGENTA};
+
+#if defined(PLATFORM_WEB)
+    emscripten_set_main_loop(UpdateDrawFrame, 0, 1);
+#else
+    SetTargetFPS(60);   // Set our game to run at 60 frames-per-second
+    
+    // Main game loop
+    while (!WindowShouldClose())    // Detect window close button or ESC key
+    {
+        UpdateDrawFrame();
+    }
+#endif
+    //--------------------------------------
+    // De-Initialization
+    //--------------------------------------
+    if (center) free_entity(center);
+
+    UnloadEntityRenderer();
+    CloseWindow();        // Close window and OpenGL context
+
+    return 0;
+}
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition
+//----------------------------------------------------------------------------------
+void UpdateDrawFrame(void)
+{
+    //--------------------------------------
+    // Update
+    //--------------------------------------
+    dt = GetFrameTime();
+
+    turn_entity(center,0.f, .3f, 0.f, TFORM_LOCAL);
+    turn_entity(child1,0.f, .6f, 0.f, TFORM_LOCAL);
+    turn_entity(child2,0.f,-2.f, 0.f, TFORM_LOCAL);
+
+    entity_update_world_all();
+
+    Matrix viewproj = MatrixMultiply(GetCameraMatrix(camera),
+        MatrixPerspective(camera.fovy*DEG2RAD, (double)GetScreenWidth()/GetScreenHeight(), CULL_DISTANCE_NEAR, CULL_DISTANCE_FAR));
+    int visible = entity_cull(viewproj, draw_visible, MAX_DRAW_ENTITIES);
+    if (visible > MAX_DRAW_ENTITIES) visible = MAX_DRAW_ENTITIES;
+
+    //--------------------------------------
+    // Draw
+    //--------------------------------------
+    draw_calls = 0;
+    draw_instances = 0;
+
+    BeginDrawing();
+
+        ClearBackground(WHITE);
+
+        BeginMode3D(camera);
+            for (int i = 0; i < visible; i++)
+                for (int k = 0; k < MAX_DRAW_ENTITIES; k++)
+                    if (draw_entities[k].id == draw_visible[i]) DrawEntityModel(draw_entities[k].id, *draw_entities[k].model, draw_entities[k].tint);
+            FlushEntityModels();
+
+            DrawEntityOrbit(child1, GREEN);
+            DrawEntityOrbit(child2, BLUE);
+            DrawEntityOrbit(child3, MAGENTA);
+
+            DrawGrid(10, 1.f);
+        EndMode3D();
+
+        // draw texts
+        DrawFPS(0, 0);
+        DrawText(TextFormat("draw calls: %i, instances: %i", draw_calls, draw_instances), 0, 20, 10, DARKGRAY);
+        DrawText(TextFormat("visible: %i, culled: %i, branches: %i", entity_get_stats().cull_visible, entity_get_stats().cull_culled, entity_get_stats().cull_branches), 0, 32, 10, DARKGRAY);
+
+    EndDrawing();
+}
+
+void InitEntityRenderer(void) {
+    draw_instanced = LoadShaderFromMemory(draw_instanced_vs, draw_instanced_fs);
+    draw_instanced.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(draw_instanced, "mvp");
+    draw_instanced.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(draw_instanced, "instanceTransform");
+    draw_instanced_tint = GetShaderLocationAttrib(draw_instanced, "instanceTint");
+    if (draw_instanced.locs[SHADER_LOC_MATRIX_MODEL] == -1 || draw_instanced_tint == -1) TraceLog(LOG_WARNING, TextFormat("instanced entity shader unavailable, drawing one mesh at a time!"));
+}
+
+void UnloadEntityRenderer(void) {
+    for (int i = 0; i < MAX_DRAW_BATCHES; i++) {
+        MemFree(draw_batches[i].transforms);
+        MemFree(draw_batches[i].tints);
+        draw_batches[i] = (draw_batch_t){0};
+    }
+    draw_batch_count = 0;
+    UnloadShader(draw_instanced);
+}
+
+// Queue a entity model, drawn by the next FlushEntityModels
+void DrawEntityModel(entity_id_t e, Model model, Color tint) {
+    draw_batch_t *b = NULL;
+    for (int i = 0; i < draw_batch_count && !b; i++) {
+        draw_batch_t *c = &draw_batches[i];
+        if (c->model.meshes == model.meshes) b = c;
+    }
+    if (!b) {
+        if (draw_batch_count == MAX_DRAW_BATCHES) FlushEntityModels();
+        b = &draw_batches[draw_batch_count++];
+        b->model = model;
+        b->count = 0;
+    }
+    if (b->count == b->capacity) {
+        b->capacity = (b->capacity) ? b->capacity*2 : 64;
+        b->transforms = (Matrix*)MemRealloc(b->transforms, b->capacity*sizeof(Matrix));
+        b->tints = (Color*)MemRealloc(b->tints, b->capacity*sizeof(Color));
+        if (!b->transforms || !b->tints) {
+            TraceLog(LOG_ERROR, TextFormat("unable allocate memory to draw entities!"));
+            exit(1);
+        }
+    }
+    b->transforms[b->count] = entity_get_tform(e, TFORM_WORLD);
+    b->tints[b->count++] = tint;
+}
+
+// Draw every queued entity model, one instanced draw call per batch and mesh
+void FlushEntityModels(void) {
+    bool instancing = draw_instanced.locs[SHADER_LOC_MATRIX_MODEL] != -1 && draw_instanced_tint != -1;
+    for (int k = 0; k < draw_batch_count; k++) {
+        draw_batch_t *b = &draw_batches[k];
+        Model model = b->model;
+        for (int i = 0; i < model.meshCount; i++)
+        {
+            Material material = model.materials[model.meshMaterial[i]];
+            Color color = material.maps[MATERIAL_MAP_DIFFUSE].color;
+            if (b->count > 1 && instancing) {
+                // tints go in a per-instance attribute of the mesh vertex array, DrawMeshInstanced adds the transforms
+                unsigned int tints = rlLoadVertexBuffer(b->tints, b->count*sizeof(Color), false);
+                rlEnableVertexArray(model.meshes[i].vaoId);
+                rlEnableVertexBuffer(tints);
+                rlEnableVertexAttribute(draw_instanced_tint);
+                rlSetVertexAttribute(draw_instanced_tint, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+                rlSetVertexAttributeDivisor(draw_instanced_tint, 1);
+                rlDisableVertexBuffer();
+                rlDisableVertexArray();
+
+                material.shader = draw_instanced;
+                DrawMeshInstanced(model.meshes[i], material, b->transforms, b->count);
+                draw_calls++;
+
+                rlEnableVertexArray(model.meshes[i].vaoId);
+                rlDisableVertexAttribute(draw_instanced_tint);
+                rlDisableVertexArray();
+                rlUnloadVertexBuffer(tints);
+            } else {
+                for (int n = 0; n < b->count; n++) {
+                    material.maps[MATERIAL_MAP_DIFFUSE].color = TintColor(color, b->tints[n]);
+                    DrawMesh(model.meshes[i], material, b->transforms[n]);
+                }
+                draw_calls += b->count;
+            }
+            material.maps[MATERIAL_MAP_DIFFUSE].color = color;
+        }
+        draw_instances += b->count;
+        b->count = 0;
+    }
+    draw_batch_count = 0;
+}
+
+void DrawEntityOrbit(entity_id_t e, Color tint) {
+    entity_id_t parent = entity_get_parent(e);
+    if (parent) {
+        Vector3 axis; 
+        float angle, length;
+        length = Vector3Length(Vector3Subtract(entity_get_position(parent, TFORM_WORLD), entity_get_position(e, TFORM_WORLD)));
+        QuaternionToAxisAngle(entity_get_rotation(parent, TFORM_WORLD), &axis, &angle);
+        DrawCircle3D(entity_get_position(parent, TFORM_WORLD), length, (Vector3){1.f, 0.f, 0.f}, 90.f, tint); //FIXME: axis, angle!
+    }
+}
+
+// Get color multiplied by tint, like DrawModel does
+Color TintColor(Color color, Color tint) {
+    Color result = WHITE;
+    result.r = (unsigned char)((((float)color.r/255.0)*((float)tint.r/255.0))*255.0f);
+    result.g = (unsigned char)((((float)color.g/255.0)*((float)tint.g/255.0))*255.0f);
+    result.b = (unsigned char)((((float)color.b/255.0)*((float)tint.b/255.0))*255.0f);
+    result.a = (unsigned char)((((float)color.a/255.0)*((float)tint.a/255.0))*255.0f);
+    return result;
+}